@@ -41,23 +41,26 @@ public:
     DataPlacementEngineType dpeType;
     double hit,total;
     int max_num_files;
+    size_t max_prefetch_events;
+    long prefetch_window_us;
 
 
     ConfigurationManager():
     num_servers(1),is_server(false),ranks_per_server(1),comm_threads_per_server(1),my_server(0),my_rank_server(0),num_workers(1),
-    dpeType(DataPlacementEngineType::MAX_BW),server_comm(),hit(0.0),total(0.0),max_num_files(1){
-        AutoTrace trace = AutoTrace("ConfigurationManager");
+    dpeType(DataPlacementEngineType::MAX_BW),server_comm(),hit(0.0),total(0.0),max_num_files(1),
+    max_prefetch_events(MAX_PREFETCH_EVENTS),prefetch_window_us(PREFETCH_WINDOW_US){
+        AUTO_TRACE("ConfigurationManager");
         MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
         MPI_Comm_rank(MPI_COMM_WORLD, &my_rank_world);
         max_num_files=comm_size;
     }
     void UpdateServerComm(){
-        AutoTrace trace = AutoTrace("ConfigurationManager::UpdateServerComm");
+        AUTO_TRACE("ConfigurationManager::UpdateServerComm");
         MPI_Comm_split(MPI_COMM_WORLD, is_server, my_rank_world, &server_comm);
         if(is_server) MPI_Comm_rank(server_comm, &my_rank_server);
     }
     void BuildLayers(LayerInfo* layers,size_t count){
-        AutoTrace trace = AutoTrace("ConfigurationManager::BuildLayers",count);
+        AUTO_TRACE("ConfigurationManager::BuildLayers",count);
         Layer* current_layer=NULL;
         Layer* previous_layer=NULL;
         for(int order=0;order<count;order++){
@@ -68,7 +71,11 @@ public:
             current_layer->id_=order+1;
             current_layer->capacity_mb_=layers[order].capacity_mb_;
             current_layer->io_client_type=layers[order].is_memory?IOClientType::SIMPLE_MEMORY:layers[order].is_local?IOClientType::LOCAL_POSIX_FILE:IOClientType::SHARED_POSIX_FILE;
+            /* local file layers with a queue depth submit their I/O through io_uring */
+            if(current_layer->io_client_type == IOClientType::LOCAL_POSIX_FILE && layers[order].io_queue_depth > 0)
+                current_layer->io_client_type = IOClientType::URING_LOCAL_FILE;
             current_layer->direct_io=layers[order].direct_io;
+            current_layer->io_queue_depth=layers[order].io_queue_depth;
             current_layer->bandwidth_mbps_=layers[order].bandwidth;
             strcpy(current_layer->layer_loc.data(),layers[order].mount_point_);
             current_layer->previous=previous_layer == NULL?nullptr:previous_layer;
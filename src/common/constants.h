@@ -31,12 +31,45 @@
 #define HFETCH_CONSTANTS_H
 const uint16_t RPC_PORT=8080;
 const size_t MAX_STRING_LENGTH=256;
-const size_t MAX_PREFETCH_EVENTS=1;
+const size_t MAX_PREFETCH_EVENTS=64;
+const long PREFETCH_WINDOW_US=1000;
+const long EVENT_WAIT_TIMEOUT_US=100000;
+const size_t EVENT_RING_SIZE=1024;
+const int MAX_EVENT_WORKERS=64;
+const size_t MOVEMENT_THREADS_PER_TIER_PAIR=2;
+const size_t READ_AHEAD_INITIAL_WINDOW=2;
+const size_t READ_AHEAD_MAX_WINDOW=64;
+const size_t READ_AHEAD_SIZE_HISTORY=8; /* read sizes of a stream its typical request size is taken from */
 const double LAMDA_FOR_SCORE=0.5;
 const std::string FILE_SEPARATOR="/";
 const size_t MB=1024*1024;
 const ScoreType DEFAULT_SCORE_TYPE=ScoreType::LRF_SCORE;
 const int SEGMENT_SIZE=16*1024*1024;
+const size_t MAX_CACHED_DESCRIPTORS=256;
+const size_t DIRECT_IO_ALIGNMENT=4096;
+const size_t DIRECT_IO_BUFFER_SIZE=4*1024*1024;
+const size_t MAX_POOLED_DIRECT_IO_BUFFERS=16;
+const size_t URING_BUFFER_SIZE=1024*1024;
+const size_t MOVE_CHUNK_SIZE=4*1024*1024;
+const int FILE_ID_SERVER_SHIFT=48; /* bits of a FileId below the interning server */
+const FileId BUFFER_FILE_TAG=1ULL<<63; /* marks ids of buffer files generated by hfetch */
+const size_t CONTAINER_FILE_SIZE=1024*MB;
+const long COMPACTION_INTERVAL_MS=1000;
+const double COMPACTION_FREE_RATIO=0.25; /* free share below the last extent that starts a compaction */
+const size_t MAX_COMPACTION_MOVES=16;
+const double EVICTION_HIGH_WATERMARK=0.9; /* share of a tier used before its evictor starts */
+const double EVICTION_LOW_WATERMARK=0.75; /* share of a tier the evictor brings the usage down to */
+const long EVICTION_INTERVAL_MS=100;
+const size_t MIN_IO_BUFFER_SIZE=4096; /* smallest block of the IOBuffer pool */
+const size_t MAX_POOLED_IO_BUFFER_SIZE=64*1024*1024; /* larger blocks are not kept by the pool */
+const size_t MAX_POOLED_IO_BYTES=128*MB; /* free bytes the IOBuffer pool of a process keeps over all size classes */
+const long RPC_BROADCAST_TIMEOUT_MS=5000; /* deadline of the answers to one broadcast */
+const uint64_t SEQUENCE_LEASE_SIZE=1024; /* ids a process takes from a GlobalSequence at once */
+const uint16_t HASH_MAP_STRIPES=16; /* independently locked sub maps of a DistributedHashMap on one server */
+const size_t SHM_SEGMENT_INITIAL_SIZE=1*MB; /* starting size of the segment of a distributed container */
+const size_t OFFSET_MAP_SEGMENT_SIZE=64*1024; /* starting size of the per file offset maps of the auditor */
+const double SHM_SEGMENT_FREE_RATIO=0.25; /* a segment doubles once less than this share of it is free */
+const long QUEUE_WAIT_SLICE_MS=100; /* longest a blocked queue waiter holds off the growth of its segment */
 
 
 
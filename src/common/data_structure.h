@@ -31,6 +31,7 @@
 #include <cstring>
 #include <src/common/constants.h>
 #include <src/common/enumerations.h>
+#include <src/common/io_buffer.h>
 #include <rpc/msgpack.hpp>
 #include <math.h>
 #include <boost/interprocess/containers/string.hpp>
@@ -45,6 +46,7 @@ typedef struct LayerInfo {
     bool is_memory;
     bool is_local;
     bool direct_io;
+    uint16_t io_queue_depth; /* io_uring queue depth, 0 for synchronous I/O */
 } LayerInfo;
 
 /* Input args structure for both lib and server */
@@ -58,6 +60,9 @@ typedef struct InputArgs{
     size_t direct_io_;
     int ranks_per_server_;
     size_t num_workers;
+    size_t max_prefetch_events;
+    long prefetch_window_us;
+    DataPlacementEngineType dpe_type;
     int max_files;
     int num_servers;
     int comm_threads_per_server;
@@ -94,6 +99,10 @@ public:
     bool operator==(const CharStruct &o) const {
         return strcmp(value,o.value)==0;
     }
+    /* less than operator for ordering two CharStruct. */
+    bool operator<(const CharStruct &o) const {
+        return strcmp(value,o.value)<0;
+    }
 } CharStruct;
 
 /* represents the file segment data structure and all its required methods */
@@ -111,9 +120,9 @@ typedef struct Segment{
         return *this;
     }
 
-    /* less than operator for comparing two Segment. */
+    /* less than operator for comparing two Segment. Orders by start and then by end. */
     bool operator<(const Segment &o) const {
-        return o.start > start;
+        return start < o.start || (start == o.start && end < o.end);
     }
 
     /* greater than operator for comparing two Segment. */
@@ -145,8 +154,17 @@ typedef struct Segment{
      * @return true if it contains else false.
      */
     bool Contains(const Segment &o) const {
-        return (start <= o.start && end >= o.end) ||
-                (start <= o.end && end >= o.end);
+        return start <= o.start && end >= o.end;
+    }
+
+    /**
+     * Checks if the current Segment and the given Segment share at least one offset.
+     *
+     * @param o, given Segment
+     * @return true if they overlap else false.
+     */
+    bool Overlaps(const Segment &o) const {
+        return start <= o.end && o.start <= end;
     }
 
     /**
@@ -254,18 +272,18 @@ typedef struct SegmentScore{
 
 /* represents an event in the system */
 typedef struct Event{
-    CharStruct filename;
+    FileId file_id;
     Segment segment;
     EventType event_type;
     EventSource source;
     uint8_t layer_index;
     HTime time;
-    Event():filename(),segment(),event_type(),source(),layer_index(),time(){}
-    Event(const Event &other) : filename(other.filename),segment(other.segment),event_type(other.event_type),source(other.source),layer_index(other.layer_index),time(other.time) {} /* copy constructor */
-    Event(Event &&other) : filename(other.filename),segment(other.segment),event_type(other.event_type),source(other.source),layer_index(other.layer_index),time(other.time) {} /* move constructor*/
+    Event():file_id(),segment(),event_type(),source(),layer_index(),time(){}
+    Event(const Event &other) : file_id(other.file_id),segment(other.segment),event_type(other.event_type),source(other.source),layer_index(other.layer_index),time(other.time) {} /* copy constructor */
+    Event(Event &&other) : file_id(other.file_id),segment(other.segment),event_type(other.event_type),source(other.source),layer_index(other.layer_index),time(other.time) {} /* move constructor*/
     /* Assignment Operator */
     Event &operator=(const Event &other) {
-        filename=other.filename;
+        file_id=other.file_id;
         segment=other.segment;
         event_type=other.event_type;
         source=other.source;
@@ -289,6 +307,7 @@ struct Layer {
     Layer *next; /* pointer to next layer. */
     Layer *previous; /* pointer to previous layer. */
     bool direct_io;
+    uint16_t io_queue_depth; /* operations in flight per process for URING_LOCAL_FILE layers. */
     IOClientType io_client_type; /* Type of IO Client to use for the layer*/
     /**
      * Constructors
@@ -302,6 +321,7 @@ struct Layer {
             next(other.next),
             previous(other.previous),
             direct_io(other.direct_io),
+            io_queue_depth(other.io_queue_depth),
             io_client_type(other.io_client_type) {} /* copy constructor */
     /* parameterized constructor */
     Layer(uint8_t id){
@@ -314,6 +334,8 @@ struct Layer {
                 next=current->next;
                 previous=current->previous;
                 bandwidth_mbps_=current->bandwidth_mbps_;
+                direct_io=current->direct_io;
+                io_queue_depth=current->io_queue_depth;
                 io_client_type=current->io_client_type;
                 break;
             }
@@ -353,27 +375,67 @@ struct Layer {
 
 /* represents a complete file structure */
 typedef struct PosixFile{
-    CharStruct filename;
+    FileId file_id;
     Segment segment;
     Layer layer;
-    std::string data;
-    PosixFile():filename(),segment(),layer(*Layer::LAST),data(){}
-    PosixFile(const PosixFile &other) : filename(other.filename),segment(other.segment),layer(other.layer),data(other.data) {} /* copy constructor */
-    PosixFile(PosixFile &&other) : filename(other.filename),segment(other.segment),layer(other.layer),data(other.data) {} /* move constructor*/
+    IOBuffer data; /* shared with copies of the file, see IOBuffer */
+    PosixFile():file_id(),segment(),layer(*Layer::LAST),data(){}
+    PosixFile(const PosixFile &other) : file_id(other.file_id),segment(other.segment),layer(other.layer),data(other.data) {} /* copy constructor */
+    PosixFile(PosixFile &&other) noexcept : file_id(other.file_id),segment(other.segment),layer(other.layer),data(std::move(other.data)) {} /* move constructor*/
     /* Assignment Operator */
     PosixFile &operator=(const PosixFile &other) {
-        filename=other.filename;
+        file_id=other.file_id;
         segment=other.segment;
         layer=other.layer;
         data=other.data;
         return *this;
     }
+    /* Move Assignment Operator */
+    PosixFile &operator=(PosixFile &&other) noexcept {
+        file_id=other.file_id;
+        segment=other.segment;
+        layer=other.layer;
+        data=std::move(other.data);
+        return *this;
+    }
 
     long GetSize() const{
         return segment.GetSize();
     }
 } PosixFile;
 
+/* represents a range of a file and the buffer holding it, as kept by the layer score index */
+typedef struct BufferedSegment{
+    FileId file_id; /* original file */
+    Segment segment; /* range in the original file */
+    FileId buffer_id; /* file holding the range */
+    Segment buffer_segment; /* range in the buffer file */
+    uint8_t layer_id; /* layer of the buffer file */
+    uint16_t server; /* server holding the storage of the buffer file */
+    BufferedSegment():file_id(0),segment(),buffer_id(0),buffer_segment(),layer_id(0),server(0){}
+    BufferedSegment(const BufferedSegment &other) : file_id(other.file_id),segment(other.segment),buffer_id(other.buffer_id),
+                                                    buffer_segment(other.buffer_segment),layer_id(other.layer_id),
+                                                    server(other.server) {} /* copy constructor */
+    /* Assignment Operator */
+    BufferedSegment &operator=(const BufferedSegment &other) {
+        file_id=other.file_id;
+        segment=other.segment;
+        buffer_id=other.buffer_id;
+        buffer_segment=other.buffer_segment;
+        layer_id=other.layer_id;
+        server=other.server;
+        return *this;
+    }
+
+    long GetSize() const{
+        return buffer_segment.GetSize();
+    }
+
+    uint16_t GetServer() const{
+        return server;
+    }
+} BufferedSegment;
+
 /**
  * Hash Values
  */
@@ -512,7 +574,7 @@ namespace clmdep_msgpack {
                 template<>
                 struct convert<Event> {
                     mv1::object const& operator()(mv1::object const& o, Event& input) const {
-                        input.filename = o.via.array.ptr[0].as<CharStruct>();
+                        input.file_id = o.via.array.ptr[0].as<FileId>();
                         input.segment = o.via.array.ptr[1].as<Segment>();
                         input.event_type = o.via.array.ptr[2].as<EventType>();
                         input.source = o.via.array.ptr[3].as<EventSource>();
@@ -528,7 +590,7 @@ namespace clmdep_msgpack {
                     packer<Stream>& operator()(mv1::packer<Stream>& o, Event const& input) const {
                         // packing member variables as an array.
                         o.pack_array(6);
-                        o.pack(input.filename);
+                        o.pack(input.file_id);
                         o.pack(input.segment);
                         o.pack(input.event_type);
                         o.pack(input.source);
@@ -544,7 +606,7 @@ namespace clmdep_msgpack {
                         o.type = type::ARRAY;
                         o.via.array.size = 6;
                         o.via.array.ptr = static_cast<clmdep_msgpack::object*>(o.zone.allocate_align(sizeof(mv1::object) * o.via.array.size, MSGPACK_ZONE_ALIGNOF(mv1::object)));
-                        o.via.array.ptr[0] = mv1::object(input.filename, o.zone);
+                        o.via.array.ptr[0] = mv1::object(input.file_id, o.zone);
                         o.via.array.ptr[1] = mv1::object(input.segment, o.zone);
                         o.via.array.ptr[2] = mv1::object(input.event_type, o.zone);
                         o.via.array.ptr[3] = mv1::object(input.source, o.zone);
@@ -556,10 +618,12 @@ namespace clmdep_msgpack {
                 template<>
                 struct convert<PosixFile> {
                     mv1::object const& operator()(mv1::object const& o, PosixFile& input) const {
-                        input.filename = o.via.array.ptr[0].as<CharStruct>();
+                        input.file_id = o.via.array.ptr[0].as<FileId>();
                         input.segment = o.via.array.ptr[1].as<Segment>();
                         input.layer = Layer(o.via.array.ptr[2].as<uint8_t>());
-                        input.data = o.via.array.ptr[3].as<std::string>();
+                        mv1::object const& data = o.via.array.ptr[3];
+                        if(data.type == type::BIN) input.data = IOBuffer(data.via.bin.ptr, data.via.bin.size);
+                        else input.data = IOBuffer(data.via.str.ptr, data.via.str.size);
                        /* std::string s=o.via.array.ptr[3].as<std::string>();
                         if(s.size()>0){
                             input.data= static_cast<char *>(malloc(s.size() + 1));
@@ -575,10 +639,11 @@ namespace clmdep_msgpack {
                     packer<Stream>& operator()(mv1::packer<Stream>& o, PosixFile const& input) const {
                         // packing member variables as an array.
                         o.pack_array(4);
-                        o.pack(input.filename);
+                        o.pack(input.file_id);
                         o.pack(input.segment);
                         o.pack(input.layer.id_);
-                        o.pack(input.data);
+                        o.pack_str(input.data.size());
+                        o.pack_str_body(input.data.data(), input.data.size());
                         /*if(input.data !=NULL) o.pack(std::string(input.data));
                         else o.pack(std::string());*/
                         return o;
@@ -591,15 +656,59 @@ namespace clmdep_msgpack {
                         o.type = type::ARRAY;
                         o.via.array.size = 4;
                         o.via.array.ptr = static_cast<clmdep_msgpack::object*>(o.zone.allocate_align(sizeof(mv1::object) * o.via.array.size, MSGPACK_ZONE_ALIGNOF(mv1::object)));
-                        o.via.array.ptr[0] = mv1::object(input.filename, o.zone);
+                        o.via.array.ptr[0] = mv1::object(input.file_id, o.zone);
                         o.via.array.ptr[1] = mv1::object(input.segment, o.zone);
                         o.via.array.ptr[2] = mv1::object(input.layer.id_, o.zone);
-                        o.via.array.ptr[3] = mv1::object(input.data, o.zone);
+                        o.via.array.ptr[3] = mv1::object(std::string(input.data.data(), input.data.size()), o.zone);
                         /*if(input.data !=NULL) o.via.array.ptr[3] = mv1::object(std::string(input.data), o.zone);
                         else o.via.array.ptr[3] = mv1::object(std::string(), o.zone);*/
                     }
                 };
 
+                template<>
+                struct convert<BufferedSegment> {
+                    mv1::object const& operator()(mv1::object const& o, BufferedSegment& input) const {
+                        input.file_id = o.via.array.ptr[0].as<FileId>();
+                        input.segment = o.via.array.ptr[1].as<Segment>();
+                        input.buffer_id = o.via.array.ptr[2].as<FileId>();
+                        input.buffer_segment = o.via.array.ptr[3].as<Segment>();
+                        input.layer_id = o.via.array.ptr[4].as<uint8_t>();
+                        input.server = o.via.array.ptr[5].as<uint16_t>();
+                        return o;
+                    }
+                };
+
+                template<>
+                struct pack<BufferedSegment> {
+                    template <typename Stream>
+                    packer<Stream>& operator()(mv1::packer<Stream>& o, BufferedSegment const& input) const {
+                        // packing member variables as an array.
+                        o.pack_array(6);
+                        o.pack(input.file_id);
+                        o.pack(input.segment);
+                        o.pack(input.buffer_id);
+                        o.pack(input.buffer_segment);
+                        o.pack(input.layer_id);
+                        o.pack(input.server);
+                        return o;
+                    }
+                };
+
+                template <>
+                struct object_with_zone<BufferedSegment> {
+                    void operator()(mv1::object::with_zone& o, BufferedSegment const& input) const {
+                        o.type = type::ARRAY;
+                        o.via.array.size = 6;
+                        o.via.array.ptr = static_cast<clmdep_msgpack::object*>(o.zone.allocate_align(sizeof(mv1::object) * o.via.array.size, MSGPACK_ZONE_ALIGNOF(mv1::object)));
+                        o.via.array.ptr[0] = mv1::object(input.file_id, o.zone);
+                        o.via.array.ptr[1] = mv1::object(input.segment, o.zone);
+                        o.via.array.ptr[2] = mv1::object(input.buffer_id, o.zone);
+                        o.via.array.ptr[3] = mv1::object(input.buffer_segment, o.zone);
+                        o.via.array.ptr[4] = mv1::object(input.layer_id, o.zone);
+                        o.via.array.ptr[5] = mv1::object(input.server, o.zone);
+                    }
+                };
+
                 template <>
                 struct convert<bip::string> {
                     clmdep_msgpack::object const& operator()(clmdep_msgpack::object const& o, bip::string& v) const {
@@ -697,6 +806,7 @@ std::ostream &operator<<(std::ostream &os, SegmentScore const &m);
 std::ostream &operator<<(std::ostream &os, Event const &m);
 std::ostream &operator<<(std::ostream &os, Layer const &m);
 std::ostream &operator<<(std::ostream &os, PosixFile const &m);
+std::ostream &operator<<(std::ostream &os, BufferedSegment const &m);
 template <typename T>
 std::ostream &operator<<(std::ostream &os, std::vector<T> const &ms){
     os << "[";
@@ -43,6 +43,8 @@ std::ostream &operator<<(std::ostream &os, LayerInfo const &m){
                 << "capacity_mb_:" << m.capacity_mb_ << ","
                 << "bandwidth:" << m.bandwidth << ","
                 << "direct_io:" << m.direct_io << ","
+                << "io_queue_depth:" << m.io_queue_depth << ","
+                << "is_local:" << m.is_local << ","
                 << "is_memory:" << m.is_memory<<"}";
 }
 std::ostream &operator<<(std::ostream &os, InputArgs const &m){
@@ -50,6 +52,9 @@ std::ostream &operator<<(std::ostream &os, InputArgs const &m){
                 << "max_files:" << m.max_files<< ","
                 << "io_size_:" << m.io_size_mb<< ","
                 << "num_workers:" << m.num_workers << ","
+                << "max_prefetch_events:" << m.max_prefetch_events << ","
+                << "prefetch_window_us:" << m.prefetch_window_us << ","
+                << "dpe_type:" << m.dpe_type << ","
                 << "layer_count_:" << m.layer_count_<< ","
                 << "ranks_per_server_:" << m.ranks_per_server_<< ","
                 << "direct_io_:" << m.direct_io_ << ","
@@ -78,7 +83,7 @@ std::ostream &operator<<(std::ostream &os, SegmentScore const &m){
 std::ostream &operator<<(std::ostream &os, Event const &m){
     return os   << "{TYPE:Event," << "event_type:" << m.event_type<< ","
                 << "layer_index:" << m.layer_index << ","
-                << "filename:" << m.filename << ","
+                << "file_id:" << m.file_id << ","
                 << "segment:" << m.segment << ","
                 << "source:" << m.source << ","
                 << "time:" << m.time<<"}";
@@ -91,9 +96,17 @@ std::ostream &operator<<(std::ostream &os, Layer const &m){
                 << "io_client_type:" << m.io_client_type<<"}";
 }
 std::ostream &operator<<(std::ostream &os, PosixFile const &m){
-    return os   << "{TYPE:PosixFile," << "filename:" << m.filename << ","
+    return os   << "{TYPE:PosixFile," << "file_id:" << m.file_id << ","
                 << "segment:" << m.segment << ","
                 << "layer:" << m.layer << "}";
 }
+std::ostream &operator<<(std::ostream &os, BufferedSegment const &m){
+    return os   << "{TYPE:BufferedSegment," << "file_id:" << m.file_id << ","
+                << "segment:" << m.segment << ","
+                << "buffer_id:" << m.buffer_id << ","
+                << "buffer_segment:" << m.buffer_segment << ","
+                << "layer_id:" << m.layer_id << ","
+                << "server:" << m.server << "}";
+}
 
 
@@ -24,5 +24,57 @@
 
 #include "debug.h"
 
-int AutoTrace::rank=-1;
-int AutoTrace::item=0;
+#if defined(HERMES_TRACE) || defined(HERMES_TIMER)
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+static std::string TraceFilePrefix(){
+    const char* directory = getenv("HFETCH_TRACE_DIR");
+    return std::string(directory == NULL ? "/tmp" : directory) + "/hfetch_trace_" + std::to_string(getpid());
+}
+
+TraceRing::TraceRing():count(0),thread(static_cast<uint32_t>(syscall(SYS_gettid))),fd(-1){}
+
+TraceRing::~TraceRing(){
+    Flush();
+    if(fd != -1) close(fd);
+}
+
+void TraceRing::Flush(){
+    if(count == 0) return;
+    if(fd == -1){
+        std::string path = TraceFilePrefix() + "_" + std::to_string(thread) + ".bin";
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    }
+    if(fd != -1){
+        size_t size = count*sizeof(TraceRecord);
+        const char* buffer = reinterpret_cast<const char*>(records);
+        while(size > 0){
+            ssize_t written = write(fd, buffer, size);
+            if(written <= 0) break;
+            buffer += written;
+            size -= written;
+        }
+    }
+    count = 0;
+}
+
+uint32_t AutoTrace::RegisterSite(const char* file, int line, const char* name){
+    static std::mutex sites_mutex;
+    static uint32_t next_site = 0;
+    std::lock_guard<std::mutex> lock(sites_mutex);
+    uint32_t site = next_site++;
+    std::string path = TraceFilePrefix() + ".sites";
+    FILE* sites = fopen(path.c_str(), "a");
+    if(sites != NULL){
+        fprintf(sites, "%u;%s;%s;%d\n", site, name, file, line);
+        fclose(sites);
+    }
+    return site;
+}
+
+#endif
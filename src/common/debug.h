@@ -141,77 +141,81 @@ public:
 
 /**
  * Implement Auto tracing Mechanism.
+ * Tracing is compiled in only when HERMES_TRACE or HERMES_TIMER is defined, otherwise AUTO_TRACE expands to
+ * nothing and its arguments are never evaluated. When enabled every traced scope appends one fixed-size binary
+ * record to a ring owned by the calling thread. A full ring is written to
+ * $HFETCH_TRACE_DIR/hfetch_trace_<pid>_<tid>.bin (default /tmp) and the call sites are listed in
+ * hfetch_trace_<pid>.sites. Use hfetch_trace_decoder to turn them into text.
  */
 using namespace std;
+
+/* one traced scope */
+typedef struct TraceRecord{
+    uint64_t start_ns; /* CLOCK_MONOTONIC time the scope was entered */
+    uint64_t duration_ns; /* time spent in the scope */
+    uint32_t thread; /* kernel thread id */
+    uint32_t site; /* call site id from the sites file */
+} TraceRecord;
+
+#if defined(HERMES_TRACE) || defined(HERMES_TIMER)
+
+#include <ctime>
+
+const size_t TRACE_RING_SIZE=4096;
+
+class TraceRing {
+    TraceRecord records[TRACE_RING_SIZE];
+    size_t count;
+    uint32_t thread;
+    int fd;
+public:
+    TraceRing();
+    ~TraceRing();
+    /* ring of the calling thread */
+    static TraceRing& Get(){
+        static thread_local TraceRing ring;
+        return ring;
+    }
+    inline void Append(uint64_t start_ns, uint64_t duration_ns, uint32_t site){
+        TraceRecord &record = records[count++];
+        record.start_ns = start_ns;
+        record.duration_ns = duration_ns;
+        record.thread = thread;
+        record.site = site;
+        if(count == TRACE_RING_SIZE) Flush();
+    }
+    void Flush();
+};
+
 class AutoTrace
 {
-    Timer timer;
-    static int rank,item;
-
+    uint32_t site;
+    uint64_t start_ns;
 public:
-    template <typename... Args>
-    AutoTrace(std::string string,Args... args):m_line(string)
-    {
-        char thread_name[256];
-        pthread_getname_np(pthread_self(), thread_name,256);
-        std::stringstream stream;
-        stream << "\033[31m";
-        if(rank == -1) MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-#if defined(HERMES_TRACE) || defined(HERMES_TIMER)
-        stream <<++item<<";"<<thread_name<<";"<< rank << ";" <<m_line << ";";
-#endif
-#if  defined(HERMES_TIMER)
-        stream <<";;";
-#endif
-#ifdef HERMES_TRACE
-        auto args_obj = std::make_tuple(args...);
-        const ulong args_size = std::tuple_size<decltype(args_obj)>::value;
-        stream << "args(";
-
-        if(args_size == 0) stream << "Void";
-        else{
-            static_for<args_size>( [&](auto w){
-                    stream << std::get<w.n>(args_obj) << ", ";
-            });
-        }
-        stream << ");";
-#endif
-#if defined(HERMES_TRACE) || defined(HERMES_TIMER)
-        stream <<"start"<< endl;
-        stream << "\033[00m";
-        cout << stream.str();
-#endif
-#ifdef HERMES_TIMER
-        timer.startTime();
-#endif
+    static inline uint64_t Now(){
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<uint64_t>(time.tv_sec)*1000000000ULL + time.tv_nsec;
     }
+    /* give a call site its id and append it to the sites file, called once per site */
+    static uint32_t RegisterSite(const char* file, int line, const char* name);
+
+    explicit AutoTrace(uint32_t site_):site(site_),start_ns(Now()){}
 
     ~AutoTrace()
     {
-        std::stringstream stream;
-        char thread_name[256];
-        pthread_getname_np(pthread_self(), thread_name,256);
-        stream << "\033[31m";
-#if defined(HERMES_TRACE) || defined(HERMES_TIMER)
-        stream <<item-- <<";"<<std::string(thread_name)<<";"<< rank << ";" << m_line << ";";
-#endif
-#if defined(HERMES_TRACE)
-        stream  <<";";
-#endif
-#ifdef HERMES_TIMER
-        double end_time=timer.endTime();
-        stream  <<end_time<<";msecs;";
-#endif
-#if defined(HERMES_TRACE) || defined(HERMES_TIMER)
-        stream  <<"finish"<< endl;
-        stream << "\033[00m";
-        cout << stream.str();
-#endif
+        TraceRing::Get().Append(start_ns, Now()-start_ns, site);
     }
-private:
-    string m_line;
 };
 
+#define HERMES_TRACE_NAME(name, ...) name
+#define AUTO_TRACE(...) \
+    static const uint32_t hermes_trace_site = AutoTrace::RegisterSite(__FILE__, __LINE__, HERMES_TRACE_NAME(__VA_ARGS__,)); \
+    AutoTrace trace(hermes_trace_site)
+#else
+#define AUTO_TRACE(...)
+#endif
+
 
 
 #endif //HERMES_DEBUG_H
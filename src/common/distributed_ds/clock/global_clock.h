@@ -51,7 +51,7 @@ private:
     std::shared_ptr<RPC> rpc;
 public:
     ~GlobalClock(){
-        AutoTrace trace = AutoTrace("~GlobalClock");
+        AUTO_TRACE("~GlobalClock");
         if(is_server) bip::shared_memory_object::remove(name.c_str());
     }
     GlobalClock(std::string name_,
@@ -59,7 +59,7 @@ public:
                      uint16_t my_server_,
                      int num_servers_): is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
               comm_size(1), my_rank(0), memory_allocated(1024ULL), name(name_), segment(),func_prefix(name_){
-        AutoTrace trace = AutoTrace("GlobalClock",name_,is_server_,my_server_,num_servers_);
+        AUTO_TRACE("GlobalClock",name_,is_server_,my_server_,num_servers_);
         MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
         MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
         name=name+"_"+std::to_string(my_server);
@@ -87,21 +87,20 @@ public:
     }
 
     HTime GetTime(){
-        AutoTrace trace = AutoTrace("GlobalClock::GetTime");
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
+        AUTO_TRACE("GlobalClock::GetTime");
         auto t2 = std::chrono::high_resolution_clock::now();
         auto t =  std::chrono::duration_cast<std::chrono::microseconds>(
                 t2 - *start).count();
         return t;
     }
     HTime GetTimeServer(uint16_t server){
-        AutoTrace trace = AutoTrace("GlobalClock::GetTimeServer",server);
+        AUTO_TRACE("GlobalClock::GetTimeServer",server);
         if(my_server==server){
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
+            /* start is written once by the server, reading it needs no lock */
             auto t2 = std::chrono::high_resolution_clock::now();
             auto t =  std::chrono::duration_cast<std::chrono::microseconds>(t2 - *start).count();
             return t;
-        }return rpc->call(server,func_prefix+"GetTime").as<HTime>();
+        }return rpc->call(server,func_prefix+"_GetTime").as<HTime>();
 
     }
 
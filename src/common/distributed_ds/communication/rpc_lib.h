@@ -32,6 +32,13 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <rpc/client.h>
+#include <rpc/rpc_error.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 #include <src/common/constants.h>
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
@@ -56,14 +63,49 @@ private:
     MyVector* server_list;
     really_long memory_allocated;
     boost::interprocess::managed_shared_memory segment;
+    /* counters to confirm that pooled connections are being reused */
+    std::atomic<really_long> connect_count, call_count;
+
+    /* pool of long-lived clients owned by the calling thread, keyed by server index */
+    std::unordered_map<uint16_t,std::shared_ptr<rpc::client>>& GetClientPool(){
+        static thread_local std::unordered_map<uint16_t,std::shared_ptr<rpc::client>> clients;
+        return clients;
+    }
+
+    /**
+     * Returns a long-lived client for the given server from the calling thread's pool.
+     * A pooled client whose connection was dropped is replaced by a fresh one.
+     */
+    std::shared_ptr<rpc::client> GetClient(uint16_t server_index){
+        auto &clients = GetClientPool();
+        auto iter = clients.find(server_index);
+        if(iter != clients.end()){
+            auto state = iter->second->get_connection_state();
+            if(state == rpc::client::connection_state::initial || state == rpc::client::connection_state::connected){
+                return iter->second;
+            }
+            clients.erase(iter);
+        }
+        AUTO_TRACE("RPC::GetClient(connect)",server_index);
+        uint16_t port = server_port + server_index;
+        auto client = std::make_shared<rpc::client>(server_list->at(server_index).c_str(), port);
+        connect_count++;
+        clients.emplace(server_index,client);
+        return client;
+    }
+
+    /* Drops the pooled client of the calling thread so that the next call reconnects. */
+    void DropClient(uint16_t server_index){
+        GetClientPool().erase(server_index);
+    }
 public:
     ~RPC(){
         if(is_server) bip::shared_memory_object::remove(name.c_str());
     }
     RPC(std::string name_,bool is_server_, uint16_t my_server_, int num_servers_):
     isInitialized(false),my_server(my_server_),is_server(is_server_),server_list(),server_port(RPC_PORT),
-    num_servers(num_servers_),name(name_), memory_allocated(1024ULL * 1024ULL),segment(){
-        AutoTrace trace = AutoTrace("RPC",name_,is_server_,my_server_,num_servers_);
+    num_servers(num_servers_),name(name_), memory_allocated(1024ULL * 1024ULL),segment(),connect_count(0),call_count(0){
+        AUTO_TRACE("RPC",name_,is_server_,my_server_,num_servers_);
         if(!isInitialized){
             int total_len;
             char *final_server_list;
@@ -152,7 +194,7 @@ public:
     }
 
     void run(size_t workers=1){
-        AutoTrace trace = AutoTrace("RPC::run",workers);
+        AUTO_TRACE("RPC::run",workers);
         if(is_server)
             server->async_run(workers);
     }
@@ -161,22 +203,77 @@ public:
     RPCLIB_MSGPACK::object_handle call(uint16_t server_index,std::string const &func_name,
                                                Args... args) {
 
-        AutoTrace trace = AutoTrace("RPC::call",server_index,func_name);
-        int16_t port = server_port + server_index;
-        /* Connect to Server */
-        rpc::client client(server_list->at(server_index).c_str(), port);
-        //client.set_timeout(5000);
-        return client.call(func_name, std::forward<Args>(args)...);
+        AUTO_TRACE("RPC::call",server_index,func_name);
+        auto client = GetClient(server_index);
+        call_count++;
+        try{
+            return client->call(func_name, std::forward<Args>(args)...);
+        }catch(rpc::rpc_error &e){
+            throw;
+        }catch(std::exception &e){
+            /* connection level failure: do not reuse this connection */
+            DropClient(server_index);
+            throw;
+        }
     }
     template <typename... Args>
     std::future<RPCLIB_MSGPACK::object_handle> async_call(uint16_t server_index,std::string const &func_name,
                                        Args... args) {
-        AutoTrace trace = AutoTrace("RPC::async_call",server_index,func_name);
-        int16_t port = server_port + server_index;
-        /* Connect to Server */
-        rpc::client client(server_list->at(server_index).c_str(), port);
-        //client.set_timeout(5000);
-        return client.async_call(func_name, std::forward<Args>(args)...);
+        AUTO_TRACE("RPC::async_call",server_index,func_name);
+        auto client = GetClient(server_index);
+        call_count++;
+        return client->async_call(func_name, std::forward<Args>(args)...);
+    }
+
+    /**
+     * Call func_name on every server other than except at once, so that the cost is one round trip
+     * whatever the number of servers.
+     * @param timeout_ms, deadline for all answers from the moment the calls are issued
+     * @return answers of all the servers called
+     * @throws std::runtime_error naming the servers that failed or missed the deadline, once every
+     *         answer arrived or the deadline passed; a partial answer is never returned as complete
+     */
+    template <typename Response, typename... Args>
+    std::vector<Response> broadcast(std::string const &func_name, int except, long timeout_ms, Args... args) {
+        AUTO_TRACE("RPC::broadcast",func_name,except,timeout_ms);
+        std::vector<std::pair<uint16_t,std::future<RPCLIB_MSGPACK::object_handle>>> pending;
+        std::string failed;
+        for(int i=0;i<num_servers;++i){
+            if(i == except) continue;
+            try{
+                pending.emplace_back(i,async_call(i,func_name,args...));
+            }catch(std::exception &e){
+                DropClient(i);
+                failed += " " + std::to_string(i) + "(" + e.what() + ")";
+            }
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        std::vector<Response> responses;
+        responses.reserve(pending.size());
+        for(auto &call:pending){
+            if(call.second.wait_until(deadline) != std::future_status::ready){
+                failed += " " + std::to_string(call.first) + "(timed out)";
+                continue;
+            }
+            try{
+                responses.push_back(call.second.get().template as<Response>());
+            }catch(rpc::rpc_error &e){
+                failed += " " + std::to_string(call.first) + "(" + e.what() + ")";
+            }catch(std::exception &e){
+                DropClient(call.first);
+                failed += " " + std::to_string(call.first) + "(" + e.what() + ")";
+            }
+        }
+        if(!failed.empty()) throw std::runtime_error("RPC::broadcast of "+func_name+" incomplete, servers:"+failed);
+        return responses;
+    }
+
+    really_long GetConnectCount(){
+        return connect_count.load();
+    }
+
+    really_long GetCallCount(){
+        return call_count.load();
     }
 };
 
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_FILE_DICTIONARY_H
+#define HFETCH_FILE_DICTIONARY_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <mpi.h>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/interprocess/containers/map.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <src/common/constants.h>
+#include <src/common/data_structure.h>
+#include <src/common/debug.h>
+#include <src/common/distributed_ds/communication/rpc_lib.h>
+#include <src/common/singleton.h>
+
+namespace bip=boost::interprocess;
+
+/**
+ * Maps file names to dense 64-bit ids so that events, segment maps and RPCs carry an integer
+ * instead of a 256 byte CharStruct. A name is interned on the server its hash points to and the
+ * id keeps that server in its upper bits, so resolving an id never needs a broadcast. Buffer
+ * files generated by hfetch are tagged with BUFFER_FILE_TAG and resolve without any lookup.
+ * Both directions are cached per process as ids are never reused.
+ */
+class FileDictionary{
+private:
+    typedef std::pair<const CharStruct, FileId> NameValue;
+    typedef bip::allocator<NameValue, bip::managed_shared_memory::segment_manager> NameAllocator;
+    typedef bip::map<CharStruct, FileId, std::less<CharStruct>, NameAllocator> NameMap;
+    typedef std::pair<const FileId, CharStruct> IdValue;
+    typedef bip::allocator<IdValue, bip::managed_shared_memory::segment_manager> IdAllocator;
+    typedef bip::map<FileId, CharStruct, std::less<FileId>, IdAllocator> IdMap;
+    bool is_server;
+    uint16_t my_server;
+    int num_servers;
+    really_long memory_allocated;
+    bip::managed_shared_memory segment;
+    std::string name,func_prefix;
+    std::shared_ptr<RPC> rpc;
+    NameMap* names;
+    IdMap* ids;
+    uint64_t* counter;
+    bip::interprocess_mutex* mutex;
+    /* process local caches of both directions */
+    std::unordered_map<std::string,FileId> name_cache;
+    std::unordered_map<FileId,std::string> id_cache;
+    std::mutex cache_mutex;
+
+    uint16_t GetServer(const std::string &filename){
+        return static_cast<uint16_t>(std::hash<std::string>()(filename) % num_servers);
+    }
+    uint16_t GetServer(FileId file_id){
+        return static_cast<uint16_t>((file_id >> FILE_ID_SERVER_SHIFT) & 0x7FFF);
+    }
+public:
+    ~FileDictionary(){
+        if(is_server) bip::shared_memory_object::remove(name.c_str());
+    }
+    FileDictionary(std::string name_, bool is_server_, uint16_t my_server_, int num_servers_)
+            : is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
+              memory_allocated(1024ULL * 1024ULL * 128ULL), segment(), name(name_), func_prefix(name_),
+              names(), ids(), counter(), mutex(), name_cache(), id_cache(), cache_mutex(){
+        AUTO_TRACE("FileDictionary",name_,is_server_,my_server_,num_servers_);
+        name=name+"_"+std::to_string(my_server);
+        rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
+        if(is_server){
+            bip::shared_memory_object::remove(name.c_str());
+            segment=bip::managed_shared_memory(bip::create_only, name.c_str(), memory_allocated);
+            names = segment.construct<NameMap>("Names")(std::less<CharStruct>(), segment.get_segment_manager());
+            ids = segment.construct<IdMap>("Ids")(std::less<FileId>(), segment.get_segment_manager());
+            counter = segment.construct<uint64_t>("Counter")(0);
+            mutex = segment.construct<bip::interprocess_mutex>("mtx")();
+            std::function<FileId(CharStruct)> internFunc(std::bind(&FileDictionary::InternInServer, this, std::placeholders::_1));
+            std::function<CharStruct(FileId)> resolveFunc(std::bind(&FileDictionary::ResolveInServer, this, std::placeholders::_1));
+            rpc->bind(func_prefix+"_Intern", internFunc);
+            rpc->bind(func_prefix+"_Resolve", resolveFunc);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if(!is_server){
+            segment=bip::managed_shared_memory(bip::open_only,name.c_str());
+            names = segment.find<NameMap>("Names").first;
+            ids = segment.find<IdMap>("Ids").first;
+            counter = segment.find<uint64_t>("Counter").first;
+            mutex = segment.find<bip::interprocess_mutex>("mtx").first;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    /* id of filename on this server, assigning the next one if the name is new. */
+    FileId InternInServer(CharStruct filename){
+        bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+        auto iter = names->find(filename);
+        if(iter != names->end()) return iter->second;
+        FileId file_id = (static_cast<FileId>(my_server) << FILE_ID_SERVER_SHIFT) | ++*counter;
+        names->insert(NameValue(filename,file_id));
+        ids->insert(IdValue(file_id,filename));
+        return file_id;
+    }
+
+    /* name of an id interned on this server, empty if unknown. */
+    CharStruct ResolveInServer(FileId file_id){
+        bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+        auto iter = ids->find(file_id);
+        if(iter != ids->end()) return iter->second;
+        return CharStruct(std::string());
+    }
+
+    /**
+     * Get the id of filename, interning it on its server the first time it is seen.
+     * @param filename, name of the file as seen by the layers
+     * @return id of the file
+     */
+    FileId Intern(const std::string &filename){
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            auto iter = name_cache.find(filename);
+            if(iter != name_cache.end()) return iter->second;
+        }
+        uint16_t server = GetServer(filename);
+        FileId file_id;
+        if(server == my_server) file_id = InternInServer(CharStruct(filename));
+        else file_id = rpc->call(server,func_prefix+"_Intern",CharStruct(filename)).template as<FileId>();
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        name_cache.emplace(filename,file_id);
+        id_cache.emplace(file_id,filename);
+        return file_id;
+    }
+
+    /**
+     * Get the name of a file id.
+     * @param file_id, id returned by Intern or a tagged buffer id
+     * @return name of the file, empty if the id was never interned
+     */
+    std::string Resolve(FileId file_id){
+        if(file_id & BUFFER_FILE_TAG) return std::to_string(file_id & ~BUFFER_FILE_TAG) + ".hfetch";
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            auto iter = id_cache.find(file_id);
+            if(iter != id_cache.end()) return iter->second;
+        }
+        uint16_t server = GetServer(file_id);
+        CharStruct filename;
+        if(server == my_server) filename = ResolveInServer(file_id);
+        else filename = rpc->call(server,func_prefix+"_Resolve",file_id).template as<CharStruct>();
+        std::string resolved(filename.c_str());
+        if(resolved.empty()) return resolved;
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        id_cache.emplace(file_id,resolved);
+        name_cache.emplace(resolved,file_id);
+        return resolved;
+    }
+};
+#endif //HFETCH_FILE_DICTIONARY_H
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_GROWABLE_SEGMENT_H
+#define HFETCH_GROWABLE_SEGMENT_H
+
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/sharable_lock.hpp>
+#include <src/common/constants.h>
+
+namespace bip=boost::interprocess;
+
+/**
+ * Managed shared memory segment that starts small and grows in place when it runs low. Every access
+ * goes through Run, which holds a shared lock on a small control segment. Growing holds that lock
+ * exclusively, extends the segment and bumps its generation, so every process maps the segment again
+ * before touching it after a growth.
+ */
+class GrowableSegment{
+private:
+    typedef struct Control{
+        bip::interprocess_sharable_mutex mutex;
+        uint64_t generation;
+        size_t size;
+        explicit Control(size_t size_):mutex(),generation(0),size(size_){}
+    } Control;
+    std::string name,control_name;
+    bool owner;
+    bip::managed_shared_memory control_segment;
+    Control* control;
+    bip::managed_shared_memory segment;
+    /* generation of the mapping held by this process */
+    uint64_t generation;
+    /* threads of this process share the mapping, mapping it again is exclusive */
+    std::shared_mutex mapping_mutex;
+    /* refreshes the caller's pointers into the segment after it is mapped */
+    std::function<void(bip::managed_shared_memory&)> attach;
+
+    bool NeedsGrowth(){
+        return segment.get_free_memory() < segment.get_size() * SHM_SEGMENT_FREE_RATIO;
+    }
+
+    void Map(){
+        segment=bip::managed_shared_memory(bip::open_only,name.c_str());
+        generation=control->generation;
+        if(attach) attach(segment);
+    }
+
+    void Remap(){
+        std::unique_lock<std::shared_mutex> local(mapping_mutex);
+        bip::sharable_lock<bip::interprocess_sharable_mutex> lock(control->mutex);
+        if(generation != control->generation) Map();
+    }
+
+    /* double the segment unless another process grew it since seen */
+    void Grow(uint64_t seen){
+        std::unique_lock<std::shared_mutex> local(mapping_mutex);
+        bip::scoped_lock<bip::interprocess_sharable_mutex> lock(control->mutex);
+        if(control->generation == seen){
+            /* no process is inside the segment: extending the file and its free list is safe */
+            if(!bip::managed_shared_memory::grow(name.c_str(),control->size)) throw bip::bad_alloc();
+            control->size*=2;
+            control->generation++;
+        }
+        Map();
+    }
+
+public:
+    GrowableSegment():name(),control_name(),owner(false),control_segment(),control(nullptr),segment(),
+                      generation(0),mapping_mutex(),attach(){}
+    ~GrowableSegment(){
+        if(owner){
+            bip::shared_memory_object::remove(name.c_str());
+            bip::shared_memory_object::remove(control_name.c_str());
+        }
+    }
+
+    /* Create the segment on the server, replacing any stale one. The caller constructs its objects in Get(). */
+    void Create(std::string name_, size_t initial_size, std::function<void(bip::managed_shared_memory&)> attach_){
+        name=name_;
+        control_name=name_+"_CONTROL";
+        owner=true;
+        attach=attach_;
+        bip::shared_memory_object::remove(name.c_str());
+        bip::shared_memory_object::remove(control_name.c_str());
+        control_segment=bip::managed_shared_memory(bip::create_only,control_name.c_str(),65536);
+        control=control_segment.construct<Control>("control")(initial_size);
+        segment=bip::managed_shared_memory(bip::create_only,name.c_str(),initial_size);
+    }
+
+    /* Map the segment created by the server and call attach_ on it. */
+    void Open(std::string name_, std::function<void(bip::managed_shared_memory&)> attach_){
+        name=name_;
+        control_name=name_+"_CONTROL";
+        attach=attach_;
+        control_segment=bip::managed_shared_memory(bip::open_only,control_name.c_str());
+        control=control_segment.find<Control>("control").first;
+        bip::sharable_lock<bip::interprocess_sharable_mutex> lock(control->mutex);
+        Map();
+    }
+
+    bip::managed_shared_memory &Get(){
+        return segment;
+    }
+
+    /**
+     * Run operation against the current mapping of the segment. The segment is grown first when it
+     * is low on memory and again whenever operation runs out of it, in which case operation is retried,
+     * so it must not leave partial updates behind on an allocation failure. Must not be nested.
+     */
+    template<typename Operation>
+    auto Run(Operation operation) -> decltype(operation()){
+        while(true){
+            uint64_t seen;
+            {
+                std::shared_lock<std::shared_mutex> local(mapping_mutex);
+                bip::sharable_lock<bip::interprocess_sharable_mutex> lock(control->mutex);
+                seen=control->generation;
+                if(seen == generation && !NeedsGrowth()){
+                    try{
+                        return operation();
+                    }catch(bip::bad_alloc &){
+                        /* the segment ran out: grow it below and try again */
+                    }
+                }
+            }
+            if(seen != generation) Remap();
+            else Grow(seen);
+        }
+    }
+};
+
+#endif //HFETCH_GROWABLE_SEGMENT_H
@@ -34,6 +34,8 @@
 #include <utility>
 #include <format.h>
 #include <stdexcept>
+#include <unordered_map>
+#include <type_traits>
 /** MPI Headers**/
 #include <mpi.h>
 /** RPC Lib Headers**/
@@ -43,6 +45,9 @@
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/sharable_lock.hpp>
 //#include <unordered_map>
 #include <functional>
 #include <boost/functional/hash.hpp>
@@ -50,6 +55,7 @@
 #include <src/common/constants.h>
 #include <rpc/rpc_error.h>
 #include <src/common/distributed_ds/communication/rpc_lib.h>
+#include <src/common/distributed_ds/growable_segment.h>
 #include <src/common/singleton.h>
 #include <src/common/macros.h>
 
@@ -67,6 +73,12 @@ typedef unsigned long long int really_long;
  */
     template<typename KeyType, typename MappedType>
     class DistributedHashMap {
+    public:
+        /**
+         * Update applied to one entry by its owner under the map lock. Receives whether the key exists,
+         * the value to update in place and the caller's argument. Returns false to leave the key absent.
+         */
+        typedef std::function<bool(bool, MappedType &, const MappedType &)> MergeFunction;
     private:
         std::hash<KeyType> keyHash;
         /** Class Typedefs for ease of use **/
@@ -79,26 +91,43 @@ typedef unsigned long long int really_long;
         std::shared_ptr<RPC> rpc;
         really_long memory_allocated;
         bool is_server;
-        boost::interprocess::managed_shared_memory segment;
+        GrowableSegment segment;
         std::string name,func_prefix;
+        /* HASH_MAP_STRIPES sub maps, each guarded by its own lock so unrelated keys do not contend */
         MyHashMap *myHashMap;
-        boost::interprocess::interprocess_mutex* mutex;
-    public:
+        boost::interprocess::interprocess_sharable_mutex* mutex;
+        /* merges by name, registered identically on every process */
+        std::unordered_map<std::string,MergeFunction> merges;
 
-        /* Constructor to deallocate the shared memory*/
-        ~DistributedHashMap() {
-            if(is_server){
-                boost::interprocess::shared_memory_object::remove(name.c_str());
-            }
+        /* Increment and CompareAndSwap are only served for arithmetic values */
+        void BindArithmeticFunctions(std::true_type) {
+            std::function<std::pair<bool,MappedType>(KeyType,MappedType,bool)> incrementFunc(std::bind(&DistributedHashMap<KeyType,MappedType>::Increment, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            std::function<bool(KeyType,MappedType,MappedType)> compareAndSwapFunc(std::bind(&DistributedHashMap<KeyType,MappedType>::CompareAndSwap, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            rpc->bind(func_prefix+"_Increment", incrementFunc);
+            rpc->bind(func_prefix+"_CompareAndSwap", compareAndSwapFunc);
+        }
+        void BindArithmeticFunctions(std::false_type) {}
+
+        /* find the sub maps and their locks in a (re)mapped segment */
+        void Attach(boost::interprocess::managed_shared_memory &shm) {
+            myHashMap = shm.find<MyHashMap>(name.c_str()).first;
+            mutex = shm.find<boost::interprocess::interprocess_sharable_mutex>("mtx").first;
         }
 
+        /* sub map of key on this server, independent of the hash bits choosing the server */
+        uint16_t GetStripe(size_t key_hash) {
+            return static_cast<uint16_t>((key_hash / num_servers) % HASH_MAP_STRIPES);
+        }
+    public:
+
         explicit DistributedHashMap(std::string name_,
                                     bool is_server_,
                                     uint16_t my_server_,
-                                    int num_servers_)
+                                    int num_servers_,
+                                    really_long memory_allocated_ = SHM_SEGMENT_INITIAL_SIZE)
                 : is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
-                  comm_size(1), my_rank(0), memory_allocated(1024ULL * 1024ULL * 128ULL), name(name_), segment(),
-                  myHashMap(),func_prefix(name_) {
+                  comm_size(1), my_rank(0), memory_allocated(memory_allocated_), name(name_), segment(),
+                  myHashMap(),func_prefix(name_),merges() {
 
             /* Initialize MPI rank and size of world */
             MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
@@ -108,14 +137,12 @@ typedef unsigned long long int really_long;
             /* if current rank is a server */
             rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
             if (is_server) {
-                /* Delete existing instance of shared memory space*/
-                boost::interprocess::shared_memory_object::remove(name.c_str());
-                /* allocate new shared memory space */
-                segment = boost::interprocess::managed_shared_memory(boost::interprocess::create_only, name.c_str(), memory_allocated);
-                ShmemAllocator alloc_inst(segment.get_segment_manager());
-                mutex = segment.construct<boost::interprocess::interprocess_mutex>("mtx")();
+                /* allocate new shared memory space, replacing any existing one. It grows with the data. */
+                segment.Create(name, memory_allocated, std::bind(&DistributedHashMap<KeyType,MappedType>::Attach, this, std::placeholders::_1));
+                boost::interprocess::managed_shared_memory &shm = segment.Get();
+                mutex = shm.construct<boost::interprocess::interprocess_sharable_mutex>("mtx")[HASH_MAP_STRIPES]();
                 /* Construct Hashmap in the shared memory space. */
-                myHashMap = segment.construct<MyHashMap>(name.c_str())(128, std::hash<KeyType>(), std::equal_to<KeyType>(), segment.get_allocator<ValueType>());
+                myHashMap = shm.construct<MyHashMap>(name.c_str())[HASH_MAP_STRIPES](128, std::hash<KeyType>(), std::equal_to<KeyType>(), shm.get_allocator<ValueType>());
                 /* Create a RPC server and map the methods to it. */
                 std::function<bool(KeyType, MappedType)> putFunc(
                         std::bind(&DistributedHashMap<KeyType, MappedType>::Put, this, std::placeholders::_1,
@@ -127,22 +154,17 @@ typedef unsigned long long int really_long;
                 rpc->bind(func_prefix+"_Put", putFunc);
                 rpc->bind(func_prefix+"_Get", getFunc);
                 rpc->bind(func_prefix+"_Erase", eraseFunc);
+                std::function<std::pair<bool,MappedType>(KeyType,std::string,MappedType)> mergeFunc(std::bind(&DistributedHashMap<KeyType,MappedType>::Merge, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
                 rpc->bind(func_prefix+"_GetAllData", getAllDataInServerFunc);
+                rpc->bind(func_prefix+"_Merge", mergeFunc);
+                BindArithmeticFunctions(std::is_arithmetic<MappedType>());
                 //srv->suppress_exceptions(true);
             }
             /* Make clients wait untill all servers reach here*/
             MPI_Barrier(MPI_COMM_WORLD);
             /* Map the clients to their respective memory pools */
             if (!is_server) {
-                segment = boost::interprocess::managed_shared_memory(boost::interprocess::open_only, name.c_str());
-                std::pair<MyHashMap *, boost::interprocess::managed_shared_memory::size_type> res;
-                res = segment.find<MyHashMap>(name.c_str());
-                myHashMap = res.first;
-                size_t size=myHashMap->size();
-                std::pair<boost::interprocess::interprocess_mutex *, boost::interprocess::managed_shared_memory::size_type> res2;
-                res2 = segment.find<boost::interprocess::interprocess_mutex>("mtx");
-                mutex = res2.first;
-
+                segment.Open(name, std::bind(&DistributedHashMap<KeyType,MappedType>::Attach, this, std::placeholders::_1));
             }
             MPI_Barrier(MPI_COMM_WORLD);
         }
@@ -158,13 +180,16 @@ typedef unsigned long long int really_long;
             size_t key_hash = keyHash(key);
             uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
             if (key_int == my_server) {
-                boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-                typename MyHashMap::iterator iterator = myHashMap->find(key);
-                if (iterator != myHashMap->end()) {
-                    myHashMap->erase(key);
-                }
-                myHashMap->insert(std::pair<KeyType,MappedType>(key, data));
-                return true;
+                return segment.Run([&]() -> bool {
+                    uint16_t stripe = GetStripe(key_hash);
+                    boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(mutex[stripe]);
+                    typename MyHashMap::iterator iterator = myHashMap[stripe].find(key);
+                    if (iterator != myHashMap[stripe].end()) {
+                        myHashMap[stripe].erase(key);
+                    }
+                    myHashMap[stripe].insert(std::pair<KeyType,MappedType>(key, data));
+                    return true;
+                });
             } else {
                 return rpc->call(key_int,func_prefix+"_Put",key, data).template as<bool>();
             }
@@ -180,13 +205,16 @@ typedef unsigned long long int really_long;
             size_t key_hash = keyHash(key);
             uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
             if (key_int == my_server) {
-                boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-                typename MyHashMap::iterator iterator = myHashMap->find(key);
-                if (iterator != myHashMap->end()) {
-                    return std::pair<bool, MappedType>(true, iterator->second);
-                } else {
-                    return std::pair<bool, MappedType>(false, MappedType());
-                }
+                return segment.Run([&]() -> std::pair<bool, MappedType> {
+                    uint16_t stripe = GetStripe(key_hash);
+                    boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> lock(mutex[stripe]);
+                    typename MyHashMap::iterator iterator = myHashMap[stripe].find(key);
+                    if (iterator != myHashMap[stripe].end()) {
+                        return std::pair<bool, MappedType>(true, iterator->second);
+                    } else {
+                        return std::pair<bool, MappedType>(false, MappedType());
+                    }
+                });
             } else {
                 return rpc->call(key_int,func_prefix+"_Get",key).template as<std::pair<bool, MappedType>>();
             }
@@ -195,40 +223,124 @@ typedef unsigned long long int really_long;
             size_t key_hash = keyHash(key);
             uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
             if (key_int == my_server) {
-                boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-                size_t s = myHashMap->erase(key);
-                return std::pair<bool, MappedType>(s>0, MappedType());
+                return segment.Run([&]() -> std::pair<bool, MappedType> {
+                    uint16_t stripe = GetStripe(key_hash);
+                    boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(mutex[stripe]);
+                    size_t s = myHashMap[stripe].erase(key);
+                    return std::pair<bool, MappedType>(s>0, MappedType());
+                });
             } else {
                 return rpc->call(key_int,func_prefix+"_Erase",key).template as<std::pair<bool, MappedType>>();
             }
         }
+        /**
+         * Add delta to the value of key on its owner in one step.
+         * @param key, key to update
+         * @param delta, amount to add
+         * @param create, insert delta when the key is missing, otherwise leave it missing
+         * @return whether the key exists after the update and its new value
+         */
+        std::pair<bool,MappedType> Increment(KeyType key, MappedType delta, bool create = true) {
+            size_t key_hash = keyHash(key);
+            uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
+            if (key_int == my_server) {
+                return segment.Run([&]() -> std::pair<bool, MappedType> {
+                    uint16_t stripe = GetStripe(key_hash);
+                    boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(mutex[stripe]);
+                    typename MyHashMap::iterator iterator = myHashMap[stripe].find(key);
+                    if (iterator != myHashMap[stripe].end()) {
+                        iterator->second += delta;
+                        return std::pair<bool, MappedType>(true, iterator->second);
+                    }
+                    if (!create) return std::pair<bool, MappedType>(false, MappedType());
+                    myHashMap[stripe].insert(std::pair<KeyType,MappedType>(key, delta));
+                    return std::pair<bool, MappedType>(true, delta);
+                });
+            } else {
+                return rpc->call(key_int,func_prefix+"_Increment",key, delta, create).template as<std::pair<bool, MappedType>>();
+            }
+        }
+
+        /**
+         * Replace the value of key by desired only if it currently equals expected.
+         * @return true if the value was swapped
+         */
+        bool CompareAndSwap(KeyType key, MappedType expected, MappedType desired) {
+            size_t key_hash = keyHash(key);
+            uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
+            if (key_int == my_server) {
+                return segment.Run([&]() -> bool {
+                    uint16_t stripe = GetStripe(key_hash);
+                    boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(mutex[stripe]);
+                    typename MyHashMap::iterator iterator = myHashMap[stripe].find(key);
+                    if (iterator == myHashMap[stripe].end() || !(iterator->second == expected)) return false;
+                    iterator->second = desired;
+                    return true;
+                });
+            } else {
+                return rpc->call(key_int,func_prefix+"_CompareAndSwap",key, expected, desired).template as<bool>();
+            }
+        }
+
+        /**
+         * Register a merge under a name. Must be done on every process before any Merge with that name.
+         */
+        void RegisterMerge(std::string merge_name, MergeFunction merge) {
+            merges[merge_name] = merge;
+        }
+
+        /**
+         * Apply the registered merge to the entry of key on its owner, under the owner's lock.
+         * @return whether the key exists after the merge and its new value
+         */
+        std::pair<bool,MappedType> Merge(KeyType key, std::string merge_name, MappedType argument) {
+            size_t key_hash = keyHash(key);
+            uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
+            if (key_int == my_server) {
+                auto merge = merges.find(merge_name);
+                if (merge == merges.end()) return std::pair<bool, MappedType>(false, MappedType());
+                return segment.Run([&]() -> std::pair<bool, MappedType> {
+                    uint16_t stripe = GetStripe(key_hash);
+                    boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(mutex[stripe]);
+                    typename MyHashMap::iterator iterator = myHashMap[stripe].find(key);
+                    bool exists = iterator != myHashMap[stripe].end();
+                    MappedType value = exists ? iterator->second : MappedType();
+                    if (!merge->second(exists, value, argument)) {
+                        if (exists) myHashMap[stripe].erase(iterator);
+                        return std::pair<bool, MappedType>(false, MappedType());
+                    }
+                    if (exists) iterator->second = value;
+                    else myHashMap[stripe].insert(std::pair<KeyType,MappedType>(key, value));
+                    return std::pair<bool, MappedType>(true, value);
+                });
+            } else {
+                return rpc->call(key_int,func_prefix+"_Merge",key, merge_name, argument).template as<std::pair<bool, MappedType>>();
+            }
+        }
+
         std::vector<std::pair<KeyType,MappedType>> GetAllData() {
             std::vector<std::pair<KeyType,MappedType>> final_values=std::vector<std::pair<KeyType,MappedType>>();
-            auto current_server=GetAllDataInServer();
-            final_values.insert(final_values.end(),current_server.begin(),current_server.end());
-            for(int i=0;i<num_servers ;++i){
-                if(i!=my_server){
-                    auto server=rpc->call(i,func_prefix+"_GetAllData").template as<std::vector<std::pair<KeyType,MappedType>>>();
-                    final_values.insert(final_values.end(),server.begin(),server.end());
-                }
-
+            auto responses=rpc->template broadcast<std::vector<std::pair<KeyType,MappedType>>>(func_prefix+"_GetAllData",my_server,RPC_BROADCAST_TIMEOUT_MS);
+            final_values=GetAllDataInServer();
+            for(auto &server:responses){
+                final_values.insert(final_values.end(),std::make_move_iterator(server.begin()),std::make_move_iterator(server.end()));
             }
             return final_values;
 
         }
         std::vector<std::pair<KeyType,MappedType>> GetAllDataInServer() {
             std::vector<std::pair<KeyType, MappedType>> final_values = std::vector<std::pair<KeyType, MappedType>>();
-            {
-                boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-                typename MyHashMap::iterator lower_bound;
-                if(myHashMap->size() > 0){
-                    lower_bound = myHashMap->begin();
-                    while (lower_bound != myHashMap->end()){
+            segment.Run([&]() -> void {
+                final_values.clear();
+                for (uint16_t stripe = 0; stripe < HASH_MAP_STRIPES; ++stripe) {
+                    boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> lock(mutex[stripe]);
+                    typename MyHashMap::iterator lower_bound = myHashMap[stripe].begin();
+                    while (lower_bound != myHashMap[stripe].end()){
                         final_values.push_back(std::pair<KeyType,MappedType>(lower_bound->first, lower_bound->second));
                         lower_bound++;
                     }
                 }
-            }
+            });
             return final_values;
         }
     };
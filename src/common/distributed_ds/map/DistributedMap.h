@@ -32,6 +32,7 @@
 #include <iostream>
 #include <functional>
 #include <utility>
+#include <unordered_map>
 /** MPI Headers**/
 #include <mpi.h>
 /** RPC Lib Headers**/
@@ -41,11 +42,13 @@
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/interprocess/containers/map.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
-#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/sharable_lock.hpp>
 #include <boost/algorithm/string.hpp>
 #include <src/common/constants.h>
 #include <src/common/distributed_ds/communication/rpc_lib.h>
+#include <src/common/distributed_ds/growable_segment.h>
 #include <src/common/singleton.h>
 #include <src/common/macros.h>
 #include <src/common/configuration_manager.h>
@@ -61,6 +64,12 @@
 
 template<typename KeyType, typename MappedType, typename Compare = std::less<KeyType>>
 class DistributedMap {
+public:
+    /**
+     * Update applied to one entry by its owner under the map lock. Receives whether the key exists,
+     * the value to update in place and the caller's argument. Returns false to leave the key absent.
+     */
+    typedef std::function<bool(bool, MappedType &, const MappedType &)> MergeFunction;
 private:
     std::hash<KeyType> keyHash;
     /** Class Typedefs for ease of use **/
@@ -73,26 +82,40 @@ private:
     std::shared_ptr<RPC> rpc;
     really_long memory_allocated;
     bool is_server;
-    boost::interprocess::managed_shared_memory segment;
+    GrowableSegment segment;
     std::string name,func_prefix;
     MyMap *mymap;
-    boost::interprocess::interprocess_mutex* mutex;
+    /* readers share the map, writers hold it exclusively */
+    boost::interprocess::interprocess_sharable_mutex* mutex;
+    /* server holding every key of this map, -1 to spread keys by hash */
+    int owner;
+    /* merges by name, registered identically on every process */
+    std::unordered_map<std::string,MergeFunction> merges;
 
-public:
+    uint16_t GetServer(KeyType &key){
+        if(owner >= 0) return static_cast<uint16_t>(owner);
+        return static_cast<uint16_t>(keyHash(key) % num_servers);
+    }
 
-    /* Constructor to deallocate the shared memory*/
-    ~DistributedMap(){
-        if(is_server) boost::interprocess::shared_memory_object::remove(name.c_str());
+    /* find the map and its lock in a (re)mapped segment */
+    void Attach(boost::interprocess::managed_shared_memory &shm){
+        mymap = shm.find<MyMap>(name.c_str()).first;
+        mutex = shm.find<boost::interprocess::interprocess_sharable_mutex>("mtx").first;
     }
 
+public:
+
     explicit DistributedMap(){}
     explicit DistributedMap(std::string name_,
                             bool is_server_,
                             uint16_t my_server_,
-                            int num_servers_)
+                            int num_servers_,
+                            int owner_ = -1,
+                            really_long memory_allocated_ = SHM_SEGMENT_INITIAL_SIZE)
             : is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
-              comm_size(1), my_rank(0), memory_allocated(1024ULL * 1024ULL * 128ULL), name(name_), segment(), mymap(),func_prefix(name_){
-        AutoTrace trace = AutoTrace("DistributedMap",name_,is_server_,my_server_,num_servers_);
+              comm_size(1), my_rank(0), memory_allocated(memory_allocated_), name(name_), segment(), mymap(),func_prefix(name_),
+              owner(owner_),merges(){
+        AUTO_TRACE("DistributedMap",name_,is_server_,my_server_,num_servers_,owner_);
         /* Initialize MPI rank and size of world */
         MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
         MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
@@ -101,14 +124,13 @@ public:
         /* if current rank is a server */
         rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
         if (is_server) {
-            /* Delete existing instance of shared memory space*/
-            boost::interprocess::shared_memory_object::remove(name.c_str());
-            /* allocate new shared memory space */
-            segment=boost::interprocess::managed_shared_memory(boost::interprocess::create_only,name.c_str(),memory_allocated);
-            ShmemAllocator alloc_inst (segment.get_segment_manager());
+            /* allocate new shared memory space, replacing any existing one. It grows with the data. */
+            segment.Create(name,memory_allocated,std::bind(&DistributedMap<KeyType,MappedType,Compare>::Attach, this, std::placeholders::_1));
+            boost::interprocess::managed_shared_memory &shm = segment.Get();
+            ShmemAllocator alloc_inst (shm.get_segment_manager());
             /* Construct Hashmap in the shared memory space. */
-            mymap = segment.construct<MyMap>(name.c_str())(Compare() ,alloc_inst);
-            mutex = segment.construct<boost::interprocess::interprocess_mutex>("mtx")();
+            mymap = shm.construct<MyMap>(name.c_str())(Compare() ,alloc_inst);
+            mutex = shm.construct<boost::interprocess::interprocess_sharable_mutex>("mtx")();
             /* Create a RPC server and map the methods to it. */
             std::function<bool(KeyType,MappedType)> putFunc(std::bind(&DistributedMap<KeyType,MappedType,Compare>::Put, this, std::placeholders::_1 , std::placeholders::_2));
             std::function<std::pair<bool,MappedType>(KeyType)> getFunc(std::bind(&DistributedMap<KeyType,MappedType,Compare>::Get, this, std::placeholders::_1 ));
@@ -119,18 +141,16 @@ public:
             rpc->bind(func_prefix+"_Get", getFunc);
             rpc->bind(func_prefix+"_Erase", eraseFunc);
             rpc->bind(func_prefix+"_GetAllData", getAllDataInServerFunc);
+            std::function<std::pair<bool,MappedType>(KeyType,std::string,MappedType)> mergeFunc(std::bind(&DistributedMap<KeyType,MappedType,Compare>::Merge, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            std::function<std::vector<std::pair<KeyType,MappedType>>(KeyType,std::string,MappedType)> mergeOverlappingInServerFunc(std::bind(&DistributedMap<KeyType,MappedType,Compare>::MergeOverlappingInServer, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
             rpc->bind(func_prefix+"_Contains", containsInServerFunc);
+            rpc->bind(func_prefix+"_Merge", mergeFunc);
+            rpc->bind(func_prefix+"_MergeOverlapping", mergeOverlappingInServerFunc);
         }
         MPI_Barrier(MPI_COMM_WORLD);
         /* Map the clients to their respective memory pools */
         if(!is_server){
-            segment=boost::interprocess::managed_shared_memory(boost::interprocess::open_only,name.c_str());
-            std::pair<MyMap*,boost::interprocess:: managed_shared_memory::size_type> res;
-            res = segment.find<MyMap> (name.c_str());
-            mymap = res.first;
-            std::pair<boost::interprocess::interprocess_mutex *, boost::interprocess::managed_shared_memory::size_type> res2;
-            res2 = segment.find<boost::interprocess::interprocess_mutex>("mtx");
-            mutex = res2.first;
+            segment.Open(name,std::bind(&DistributedMap<KeyType,MappedType,Compare>::Attach, this, std::placeholders::_1));
         }
         MPI_Barrier(MPI_COMM_WORLD);
     }
@@ -141,19 +161,20 @@ public:
      * @return bool, true if Put was successful else false.
      */
     bool Put(KeyType key, MappedType data){
-        size_t key_hash = keyHash(key);
-        uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
+        uint16_t key_int = GetServer(key);
         if(key_int == my_server){
-            AutoTrace trace = AutoTrace("DistributedMap::Put(local)",key,data);
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            typename MyMap::iterator iterator = mymap->find(key);
-            if (iterator != mymap->end()) {
-                mymap->erase(iterator);
-            }
-            mymap->insert(std::pair<KeyType,MappedType>(key, data));
-            return true;
+            AUTO_TRACE("DistributedMap::Put(local)",key,data);
+            return segment.Run([&]() -> bool {
+                boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+                typename MyMap::iterator iterator = mymap->find(key);
+                if (iterator != mymap->end()) {
+                    mymap->erase(iterator);
+                }
+                mymap->insert(std::pair<KeyType,MappedType>(key, data));
+                return true;
+            });
         }else{
-            AutoTrace trace = AutoTrace("DistributedMap::Put(remote)",key,data);
+            AUTO_TRACE("DistributedMap::Put(remote)",key,data);
             return rpc->call(key_int,func_prefix+"_Put",key, data).template as<bool>();
         }
     }
@@ -164,118 +185,199 @@ public:
      *          and is present in value part else bool is set to false
      */
     std::pair<bool,MappedType> Get(KeyType key) {
-        size_t key_hash = keyHash(key);
-        uint16_t key_int = key_hash % num_servers;
+        uint16_t key_int = GetServer(key);
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedMap::Get(local)",key);
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            typename MyMap::iterator iterator = mymap->find(key);
-            if (iterator != mymap->end()) {
-                return std::pair<bool, MappedType>(true, iterator->second);
-            } else {
-                return std::pair<bool, MappedType>(false, MappedType());
-            }
+            AUTO_TRACE("DistributedMap::Get(local)",key);
+            return segment.Run([&]() -> std::pair<bool, MappedType> {
+                boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+                typename MyMap::iterator iterator = mymap->find(key);
+                if (iterator != mymap->end()) {
+                    return std::pair<bool, MappedType>(true, iterator->second);
+                } else {
+                    return std::pair<bool, MappedType>(false, MappedType());
+                }
+            });
         } else {
-            AutoTrace trace = AutoTrace("DistributedMap::Get(remote)",key);
+            AUTO_TRACE("DistributedMap::Get(remote)",key);
             return rpc->call(key_int,func_prefix+"_Get",key).template as<std::pair<bool, MappedType>>();
         }
     }
 
     std::pair<bool,MappedType> Erase(KeyType key) {
-        size_t key_hash = keyHash(key);
-        uint16_t key_int = key_hash % num_servers;
+        uint16_t key_int = GetServer(key);
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedMap::Erase(local)",key);
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            size_t s = mymap->erase(key);
-            return std::pair<bool, MappedType>(s>0, MappedType());
+            AUTO_TRACE("DistributedMap::Erase(local)",key);
+            return segment.Run([&]() -> std::pair<bool, MappedType> {
+                boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+                size_t s = mymap->erase(key);
+                return std::pair<bool, MappedType>(s>0, MappedType());
+            });
         } else {
-            AutoTrace trace = AutoTrace("DistributedMap::Erase(remote)",key);
+            AUTO_TRACE("DistributedMap::Erase(remote)",key);
             return rpc->call(key_int,func_prefix+"_Erase",key).template as<std::pair<bool, MappedType>>();
         }
     }
 
     /**
-     * Get the data into the hashmap. Uses key to decide the server to hash it to,
-     * @param key, key to get
-     * @return return a pair of bool and Value. If bool is true then data was found
-     *          and is present in value part else bool is set to false
+     * Register a merge under a name. Must be done on every process before any merge with that name.
+     */
+    void RegisterMerge(std::string merge_name, MergeFunction merge){
+        merges[merge_name] = merge;
+    }
+
+    /**
+     * Apply the registered merge to the entry of key on its server, under that server's lock.
+     * @return whether the key exists after the merge and its new value
+     */
+    std::pair<bool,MappedType> Merge(KeyType key, std::string merge_name, MappedType argument) {
+        uint16_t key_int = GetServer(key);
+        if (key_int == my_server) {
+            AUTO_TRACE("DistributedMap::Merge(local)",key,merge_name);
+            auto merge = merges.find(merge_name);
+            if (merge == merges.end()) return std::pair<bool, MappedType>(false, MappedType());
+            return segment.Run([&]() -> std::pair<bool, MappedType> {
+                boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+                typename MyMap::iterator iterator = mymap->find(key);
+                bool exists = iterator != mymap->end();
+                MappedType value = exists ? iterator->second : MappedType();
+                if (!merge->second(exists, value, argument)) {
+                    if (exists) mymap->erase(iterator);
+                    return std::pair<bool, MappedType>(false, MappedType());
+                }
+                if (exists) iterator->second = value;
+                else mymap->insert(std::pair<KeyType,MappedType>(key, value));
+                return std::pair<bool, MappedType>(true, value);
+            });
+        } else {
+            AUTO_TRACE("DistributedMap::Merge(remote)",key,merge_name);
+            return rpc->call(key_int,func_prefix+"_Merge",key, merge_name, argument).template as<std::pair<bool, MappedType>>();
+        }
+    }
+
+    /**
+     * Split every entry overlapping key at the bounds of key and apply the registered merge to the
+     * overlapped parts, all under the owner's lock. Requires an owner.
+     * @return the overlapping entries as they were before the merge, ordered by key
+     */
+    std::vector<std::pair<KeyType,MappedType>> MergeOverlapping(KeyType key, std::string merge_name, MappedType argument) {
+        AUTO_TRACE("DistributedMap::MergeOverlapping",key,merge_name);
+        if(owner == my_server) return MergeOverlappingInServer(key,merge_name,argument);
+        return rpc->call(owner,func_prefix+"_MergeOverlapping",key,merge_name,argument).template as<std::vector<std::pair<KeyType,MappedType>>>();
+    }
+
+    std::vector<std::pair<KeyType,MappedType>> MergeOverlappingInServer(KeyType key, std::string merge_name, MappedType argument) {
+        AUTO_TRACE("DistributedMap::MergeOverlappingInServer",key,merge_name);
+        auto merge = merges.find(merge_name);
+        if (merge == merges.end()) return std::vector<std::pair<KeyType,MappedType>>();
+        return segment.Run([&]() -> std::vector<std::pair<KeyType,MappedType>> {
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+            std::vector<std::pair<KeyType,MappedType>> previous = std::vector<std::pair<KeyType,MappedType>>();
+            std::vector<KeyType> inserted = std::vector<KeyType>();
+            typename MyMap::iterator lower_bound = mymap->lower_bound(key);
+            if (lower_bound != mymap->begin()) {
+                typename MyMap::iterator before = std::prev(lower_bound);
+                if (before->first.Overlaps(key)) lower_bound = before;
+            }
+            while (lower_bound != mymap->end() && lower_bound->first.Overlaps(key)) {
+                previous.emplace_back(lower_bound->first, lower_bound->second);
+                lower_bound = mymap->erase(lower_bound);
+            }
+            try {
+                for (auto &entry : previous) {
+                    /* parts outside key keep their value, the overlapped part is merged */
+                    for (auto &left_over : entry.first.Substract(key)) {
+                        mymap->insert(std::pair<KeyType,MappedType>(left_over, entry.second));
+                        inserted.push_back(left_over);
+                    }
+                    MappedType value = entry.second;
+                    if (merge->second(true, value, argument)) {
+                        KeyType common = key.Intersect(entry.first);
+                        mymap->insert(std::pair<KeyType,MappedType>(common, value));
+                        inserted.push_back(common);
+                    }
+                }
+            } catch (...) {
+                /* out of memory: put the entries back as they were so the merge can be retried */
+                for (auto &part : inserted) mymap->erase(part);
+                for (auto &entry : previous) mymap->insert(std::pair<KeyType,MappedType>(entry.first, entry.second));
+                throw;
+            }
+            return previous;
+        });
+    }
+
+    /**
+     * Get all the data whose key overlaps the given key. Keys must be disjoint extents,
+     * every server holding keys of the map is asked unless the map has an owner.
+     * @param key, key to look for
+     * @return return all overlapping key value pairs, ordered by key when the map has an owner.
      */
     std::vector<std::pair<KeyType,MappedType>> Contains(KeyType key) {
-        AutoTrace trace = AutoTrace("DistributedMap::Contains",key);
+        AUTO_TRACE("DistributedMap::Contains",key);
         std::vector<std::pair<KeyType,MappedType>> final_values=std::vector<std::pair<KeyType,MappedType>>();
-        auto current_server=ContainsInServer(key);
-        final_values.insert(final_values.end(),current_server.begin(),current_server.end());
-        for(int i=0;i<num_servers;++i){
-            if(i!=my_server){
-                auto server=rpc->call(i,func_prefix+"_Contains",key).template as<std::vector<std::pair<KeyType,MappedType>>>();
-                final_values.insert(final_values.end(),server.begin(),server.end());
-            }
+        if(owner >= 0){
+            /* all keys live on the owner: one lookup instead of asking every server */
+            if(owner == my_server) return ContainsInServer(key);
+            return rpc->call(owner,func_prefix+"_Contains",key).template as<std::vector<std::pair<KeyType,MappedType>>>();
+        }
+        auto responses=rpc->template broadcast<std::vector<std::pair<KeyType,MappedType>>>(func_prefix+"_Contains",my_server,RPC_BROADCAST_TIMEOUT_MS,key);
+        final_values=ContainsInServer(key);
+        for(auto &server:responses){
+            final_values.insert(final_values.end(),std::make_move_iterator(server.begin()),std::make_move_iterator(server.end()));
         }
         return final_values;
 
     }
 
     std::vector<std::pair<KeyType,MappedType>> GetAllData() {
-        AutoTrace trace = AutoTrace("DistributedMap::GetAllData");
+        AUTO_TRACE("DistributedMap::GetAllData");
         std::vector<std::pair<KeyType,MappedType>> final_values=std::vector<std::pair<KeyType,MappedType>>();
-        auto current_server=GetAllDataInServer();
-        final_values.insert(final_values.end(),current_server.begin(),current_server.end());
-        for(int i=0;i<num_servers;++i){
-            if(i!=my_server){
-                auto server=rpc->call(i,func_prefix+"_GetAllData").template as<std::vector<std::pair<KeyType,MappedType>>>();
-                final_values.insert(final_values.end(),server.begin(),server.end());
-            }
+        if(owner >= 0){
+            if(owner == my_server) return GetAllDataInServer();
+            return rpc->call(owner,func_prefix+"_GetAllData").template as<std::vector<std::pair<KeyType,MappedType>>>();
+        }
+        auto responses=rpc->template broadcast<std::vector<std::pair<KeyType,MappedType>>>(func_prefix+"_GetAllData",my_server,RPC_BROADCAST_TIMEOUT_MS);
+        final_values=GetAllDataInServer();
+        for(auto &server:responses){
+            final_values.insert(final_values.end(),std::make_move_iterator(server.begin()),std::make_move_iterator(server.end()));
         }
         return final_values;
 
     }
 
     std::vector<std::pair<KeyType,MappedType>> ContainsInServer(KeyType key) {
-        AutoTrace trace = AutoTrace("DistributedMap::ContainsInServer",key);
+        AUTO_TRACE("DistributedMap::ContainsInServer",key);
         std::vector<std::pair<KeyType,MappedType>> final_values = std::vector<std::pair<KeyType,MappedType>>();
-        {
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            typename MyMap::iterator lower_bound;
-            size_t size=mymap->size();
-            if (size == 0){
-
+        segment.Run([&]() -> void {
+            final_values.clear();
+            boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+            typename MyMap::iterator lower_bound = mymap->lower_bound(key);
+            /* keys are disjoint extents: only the one before lower_bound can start before key and still overlap it */
+            if (lower_bound != mymap->begin()) {
+                typename MyMap::iterator previous = std::prev(lower_bound);
+                if (previous->first.Overlaps(key)) lower_bound = previous;
             }
-            else if (size == 1){
-                lower_bound = mymap->begin();
+            while (lower_bound != mymap->end() && lower_bound->first.Overlaps(key)) {
                 final_values.insert(final_values.end(),std::pair<KeyType,MappedType>(lower_bound->first, lower_bound->second));
-            }
-            else {
-                lower_bound = mymap->lower_bound(key);
-                if(lower_bound==mymap->end()) return final_values;
-                if (lower_bound != mymap->begin()) {
-                    --lower_bound;
-                    if (!key.Contains(lower_bound->first)) lower_bound++;
-                }
-                while (lower_bound != mymap->end()) {
-                    if(!(key.Contains(lower_bound->first) || lower_bound->first.Contains(key))) break;
-                    final_values.insert(final_values.end(),std::pair<KeyType,MappedType>(lower_bound->first, lower_bound->second));
-                    lower_bound++;
-
-
-                }
+                lower_bound++;
             }
 
-        }
+        });
         return final_values;
     }
     std::vector<std::pair<KeyType,MappedType>> GetAllDataInServer() {
-        AutoTrace trace = AutoTrace("DistributedMap::GetAllDataInServer");
+        AUTO_TRACE("DistributedMap::GetAllDataInServer");
         std::vector<std::pair<KeyType,MappedType>> final_values = std::vector<std::pair<KeyType,MappedType>>();
-        {
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
+        segment.Run([&]() -> void {
+            final_values.clear();
+            boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
             typename MyMap::iterator lower_bound;
             lower_bound = mymap->begin();
             while (lower_bound != mymap->end()){
                 final_values.insert(final_values.end(),std::pair<KeyType,MappedType>(lower_bound->first, lower_bound->second));
                 lower_bound++;
             }
-        }
+        });
         return final_values;
     }
 };
@@ -41,11 +41,13 @@
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/interprocess/containers/map.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
-#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/sharable_lock.hpp>
 #include <boost/algorithm/string.hpp>
 #include <src/common/constants.h>
 #include <src/common/distributed_ds/communication/rpc_lib.h>
+#include <src/common/distributed_ds/growable_segment.h>
 #include <src/common/singleton.h>
 #include <src/common/macros.h>
 #include <src/common/configuration_manager.h>
@@ -73,27 +75,31 @@ private:
     std::shared_ptr<RPC> rpc;
     really_long memory_allocated;
     bool is_server;
-    boost::interprocess::managed_shared_memory segment;
+    GrowableSegment segment;
     std::string name,func_prefix;
     MyMap *mymap;
-    boost::interprocess::interprocess_mutex* mutex;
+    /* readers share the map, writers hold it exclusively */
+    boost::interprocess::interprocess_sharable_mutex* mutex;
 
-public:
 
-    /* Constructor to deallocate the shared memory*/
-    ~DistributedMultiMap(){
-        if(is_server) boost::interprocess::shared_memory_object::remove(name.c_str());
+    /* find the map and its lock in a (re)mapped segment */
+    void Attach(boost::interprocess::managed_shared_memory &shm){
+        mymap = shm.find<MyMap>(name.c_str()).first;
+        mutex = shm.find<boost::interprocess::interprocess_sharable_mutex>("mtx").first;
     }
 
+public:
+
     explicit DistributedMultiMap(){}
     explicit DistributedMultiMap(std::string name_,
                             bool is_server_,
                             uint16_t my_server_,
-                            int num_servers_)
+                            int num_servers_,
+                            really_long memory_allocated_ = SHM_SEGMENT_INITIAL_SIZE)
             : is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
-              comm_size(1), my_rank(0), memory_allocated(1024ULL * 1024ULL * 128ULL), name(name_), segment(), mymap(),func_prefix(name_){
+              comm_size(1), my_rank(0), memory_allocated(memory_allocated_), name(name_), segment(), mymap(),func_prefix(name_){
 
-        AutoTrace trace = AutoTrace("DistributedMultiMap",name_,is_server_,my_server_,num_servers_);
+        AUTO_TRACE("DistributedMultiMap",name_,is_server_,my_server_,num_servers_);
         /* Initialize MPI rank and size of world */
         MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
         MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
@@ -102,14 +108,13 @@ public:
         /* if current rank is a server */
         rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
         if (is_server) {
-            /* Delete existing instance of shared memory space*/
-            boost::interprocess::shared_memory_object::remove(name.c_str());
-            /* allocate new shared memory space */
-            segment=boost::interprocess::managed_shared_memory(boost::interprocess::create_only,name.c_str(),memory_allocated);
-            ShmemAllocator alloc_inst (segment.get_segment_manager());
+            /* allocate new shared memory space, replacing any existing one. It grows with the data. */
+            segment.Create(name,memory_allocated,std::bind(&DistributedMultiMap<KeyType,MappedType,Compare>::Attach, this, std::placeholders::_1));
+            boost::interprocess::managed_shared_memory &shm = segment.Get();
+            ShmemAllocator alloc_inst (shm.get_segment_manager());
             /* Construct Hashmap in the shared memory space. */
-            mymap = segment.construct<MyMap>(name.c_str())(Compare() ,alloc_inst);
-            mutex = segment.construct<boost::interprocess::interprocess_mutex>("mtx")();
+            mymap = shm.construct<MyMap>(name.c_str())(Compare() ,alloc_inst);
+            mutex = shm.construct<boost::interprocess::interprocess_sharable_mutex>("mtx")();
             /* Create a RPC server and map the methods to it. */
             std::function<bool(KeyType,MappedType)> putFunc(std::bind(&DistributedMultiMap<KeyType,MappedType,Compare>::Put, this, std::placeholders::_1 , std::placeholders::_2));
             std::function<std::pair<bool,MappedType>(KeyType)> getFunc(std::bind(&DistributedMultiMap<KeyType,MappedType,Compare>::Get, this, std::placeholders::_1 ));
@@ -124,13 +129,7 @@ public:
         }
         /* Map the clients to their respective memory pools */
         if(!is_server){
-            segment=boost::interprocess::managed_shared_memory(boost::interprocess::open_only,name.c_str());
-            std::pair<MyMap*,boost::interprocess:: managed_shared_memory::size_type> res;
-            res = segment.find<MyMap> (name.c_str());
-            mymap = res.first;
-            std::pair<boost::interprocess::interprocess_mutex *, boost::interprocess::managed_shared_memory::size_type> res2;
-            res2 = segment.find<boost::interprocess::interprocess_mutex>("mtx");
-            mutex = res2.first;
+            segment.Open(name,std::bind(&DistributedMultiMap<KeyType,MappedType,Compare>::Attach, this, std::placeholders::_1));
         }
     }
     /**
@@ -143,16 +142,18 @@ public:
         size_t key_hash = keyHash(key);
         uint16_t key_int = static_cast<uint16_t>(key_hash % num_servers);
         if(key_int == my_server){
-            AutoTrace trace = AutoTrace("DistributedMultiMap::Put(local)",key,data);
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            typename MyMap::iterator iterator = mymap->find(key);
-            if (iterator != mymap->end()) {
-                mymap->erase(iterator);
-            }
-            mymap->insert(std::pair<KeyType,MappedType>(key, data));
-            return true;
+            AUTO_TRACE("DistributedMultiMap::Put(local)",key,data);
+            return segment.Run([&]() -> bool {
+                boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+                typename MyMap::iterator iterator = mymap->find(key);
+                if (iterator != mymap->end()) {
+                    mymap->erase(iterator);
+                }
+                mymap->insert(std::pair<KeyType,MappedType>(key, data));
+                return true;
+            });
         }else{
-            AutoTrace trace = AutoTrace("DistributedMultiMap::Put(remote)",key,data);
+            AUTO_TRACE("DistributedMultiMap::Put(remote)",key,data);
             return rpc->call(key_int,func_prefix+"_Put",key, data).template as<bool>();
         }
     }
@@ -166,16 +167,18 @@ public:
         size_t key_hash = keyHash(key);
         uint16_t key_int = key_hash % num_servers;
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedMultiMap::Get(local)",key);
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            typename MyMap::iterator iterator = mymap->find(key);
-            if (iterator != mymap->end()) {
-                return std::pair<bool, MappedType>(true, iterator->second);
-            } else {
-                return std::pair<bool, MappedType>(false, MappedType());
-            }
+            AUTO_TRACE("DistributedMultiMap::Get(local)",key);
+            return segment.Run([&]() -> std::pair<bool, MappedType> {
+                boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+                typename MyMap::iterator iterator = mymap->find(key);
+                if (iterator != mymap->end()) {
+                    return std::pair<bool, MappedType>(true, iterator->second);
+                } else {
+                    return std::pair<bool, MappedType>(false, MappedType());
+                }
+            });
         } else {
-            AutoTrace trace = AutoTrace("DistributedMultiMap::Get(remote)",key);
+            AUTO_TRACE("DistributedMultiMap::Get(remote)",key);
             return rpc->call(key_int,func_prefix+"_Get",key).template as<std::pair<bool, MappedType>>();
         }
     }
@@ -184,12 +187,14 @@ public:
         size_t key_hash = keyHash(key);
         uint16_t key_int = key_hash % num_servers;
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedMultiMap::Erase(local)",key);
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            size_t s = mymap->erase(key);
-            return std::pair<bool, MappedType>(s>0, MappedType());
+            AUTO_TRACE("DistributedMultiMap::Erase(local)",key);
+            return segment.Run([&]() -> std::pair<bool, MappedType> {
+                boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+                size_t s = mymap->erase(key);
+                return std::pair<bool, MappedType>(s>0, MappedType());
+            });
         } else {
-            AutoTrace trace = AutoTrace("DistributedMultiMap::Erase(remote)",key);
+            AUTO_TRACE("DistributedMultiMap::Erase(remote)",key);
             return rpc->call(key_int,func_prefix+"_Erase",key).template as<std::pair<bool, MappedType>>();
         }
     }
@@ -201,80 +206,62 @@ public:
      *          and is present in value part else bool is set to false
      */
     std::vector<std::pair<KeyType,MappedType>> Contains(KeyType key) {
-        AutoTrace trace = AutoTrace("DistributedMultiMap::Contains",key);
+        AUTO_TRACE("DistributedMultiMap::Contains",key);
         std::vector<std::pair<KeyType,MappedType>> final_values=std::vector<std::pair<KeyType,MappedType>>();
-        auto current_server=ContainsInServer(key);
-        final_values.insert(final_values.end(),current_server.begin(),current_server.end());
-        for(int i=0;i<num_servers;++i){
-            if(i!=my_server){
-                auto server=rpc->call(i,func_prefix+"_Contains",key).template as<std::vector<std::pair<KeyType,MappedType>>>();
-                final_values.insert(final_values.end(),server.begin(),server.end());
-            }
+        auto responses=rpc->template broadcast<std::vector<std::pair<KeyType,MappedType>>>(func_prefix+"_Contains",my_server,RPC_BROADCAST_TIMEOUT_MS,key);
+        final_values=ContainsInServer(key);
+        for(auto &server:responses){
+            final_values.insert(final_values.end(),std::make_move_iterator(server.begin()),std::make_move_iterator(server.end()));
         }
         return final_values;
 
     }
 
     std::vector<std::pair<KeyType,MappedType>> GetAllData() {
-        AutoTrace trace = AutoTrace("DistributedMultiMap::GetAllData");
+        AUTO_TRACE("DistributedMultiMap::GetAllData");
         std::vector<std::pair<KeyType,MappedType>> final_values=std::vector<std::pair<KeyType,MappedType>>();
-        auto current_server=GetAllDataInServer();
-        final_values.insert(final_values.end(),current_server.begin(),current_server.end());
-        for(int i=0;i<num_servers;++i){
-            if(i!=my_server){
-                auto server=rpc->call(i,func_prefix+"_GetAllData").template as<std::vector<std::pair<KeyType,MappedType>>>();
-                final_values.insert(final_values.end(),server.begin(),server.end());
-            }
+        auto responses=rpc->template broadcast<std::vector<std::pair<KeyType,MappedType>>>(func_prefix+"_GetAllData",my_server,RPC_BROADCAST_TIMEOUT_MS);
+        final_values=GetAllDataInServer();
+        for(auto &server:responses){
+            final_values.insert(final_values.end(),std::make_move_iterator(server.begin()),std::make_move_iterator(server.end()));
         }
         return final_values;
 
     }
 
     std::vector<std::pair<KeyType,MappedType>> ContainsInServer(KeyType key) {
-        AutoTrace trace = AutoTrace("DistributedMultiMap::ContainsInServer",key);
+        AUTO_TRACE("DistributedMultiMap::ContainsInServer",key);
         std::vector<std::pair<KeyType,MappedType>> final_values = std::vector<std::pair<KeyType,MappedType>>();
-        {
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            typename MyMap::iterator lower_bound;
-            size_t size=mymap->size();
-            if (size == 0){
-
+        segment.Run([&]() -> void {
+            final_values.clear();
+            boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
+            typename MyMap::iterator lower_bound = mymap->lower_bound(key);
+            /* keys are disjoint extents: only the one before lower_bound can start before key and still overlap it */
+            if (lower_bound != mymap->begin()) {
+                typename MyMap::iterator previous = std::prev(lower_bound);
+                if (previous->first.Overlaps(key)) lower_bound = previous;
             }
-            else if (size == 1){
-                lower_bound = mymap->begin();
+            while (lower_bound != mymap->end() && lower_bound->first.Overlaps(key)) {
                 final_values.insert(final_values.end(),std::pair<KeyType,MappedType>(lower_bound->first, lower_bound->second));
-            }
-            else {
-                lower_bound = mymap->lower_bound(key);
-                if(lower_bound==mymap->end()) return final_values;
-                if (lower_bound != mymap->begin()) {
-                    --lower_bound;
-                    if (!key.Contains(lower_bound->first)) lower_bound++;
-                }
-                while (lower_bound != mymap->end()) {
-                    if(!(key.Contains(lower_bound->first) || lower_bound->first.Contains(key))) break;
-                    final_values.insert(final_values.end(),std::pair<KeyType,MappedType>(lower_bound->first, lower_bound->second));
-                    lower_bound++;
-
-
-                }
+                lower_bound++;
             }
 
-        }
+        });
         return final_values;
     }
     std::vector<std::pair<KeyType,MappedType>> GetAllDataInServer() {
-        AutoTrace trace = AutoTrace("DistributedMultiMap::GetAllDataInServer");
+        AUTO_TRACE("DistributedMultiMap::GetAllDataInServer");
         std::vector<std::pair<KeyType,MappedType>> final_values = std::vector<std::pair<KeyType,MappedType>>();
-        {
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
+        segment.Run([&]() -> void {
+            final_values.clear();
+            boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> lock(*mutex);
             typename MyMap::iterator lower_bound;
             lower_bound = mymap->begin();
             while (lower_bound != mymap->end()){
                 final_values.insert(final_values.end(),std::pair<KeyType,MappedType>(lower_bound->first, lower_bound->second));
                 lower_bound++;
             }
-        }
+        });
         return final_values;
     }
 };
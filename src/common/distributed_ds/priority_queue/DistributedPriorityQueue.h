@@ -90,7 +90,7 @@ public:
             : is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
               comm_size(1), my_rank(0), memory_allocated(1024ULL * 1024ULL * 128ULL), name(name_), segment(),
               queue(),func_prefix(name_){
-        AutoTrace trace = AutoTrace("DistributedPriorityQueue",name_,is_server_,my_server_,num_servers_);
+        AUTO_TRACE("DistributedPriorityQueue",name_,is_server_,my_server_,num_servers_);
         /* Initialize MPI rank and size of world */
         MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
         MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
@@ -140,12 +140,12 @@ public:
      */
     bool Push(MappedType data, uint16_t key_int){
         if(key_int == my_server){
-            AutoTrace trace = AutoTrace("DistributedPriorityQueue::Push(local)",data,key_int);
+            AUTO_TRACE("DistributedPriorityQueue::Push(local)",data,key_int);
             bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
             queue->push(data);
             return true;
         }else{
-            AutoTrace trace = AutoTrace("DistributedPriorityQueue::Push(remote)",data,key_int);
+            AUTO_TRACE("DistributedPriorityQueue::Push(remote)",data,key_int);
             return rpc->call(key_int,func_prefix+"_Push", data).template as<bool>();
         }
     }
@@ -157,7 +157,7 @@ public:
      */
     std::pair<bool,MappedType> Pop(uint16_t key_int) {
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedPriorityQueue::Pop(local)",key_int);
+            AUTO_TRACE("DistributedPriorityQueue::Pop(local)",key_int);
             bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
             if(queue->size()>0){
                 MappedType value= queue->top();
@@ -166,7 +166,7 @@ public:
             }
             return std::pair<bool,MappedType>(false,MappedType());;
         } else {
-            AutoTrace trace = AutoTrace("DistributedPriorityQueue::Pop(remote)",key_int);
+            AUTO_TRACE("DistributedPriorityQueue::Pop(remote)",key_int);
             return rpc->call(key_int,func_prefix+"_Pop").template as<std::pair<bool, MappedType>>();
         }
     }
@@ -179,7 +179,7 @@ public:
      */
     std::pair<bool,MappedType> Top(uint16_t key_int) {
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedPriorityQueue::Top(local)",key_int);
+            AUTO_TRACE("DistributedPriorityQueue::Top(local)",key_int);
             bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
             if(queue->size()>0){
                 MappedType value= queue->top();
@@ -187,7 +187,7 @@ public:
             }
             return std::pair<bool,MappedType>(false,MappedType());;
         } else {
-            AutoTrace trace = AutoTrace("DistributedPriorityQueue::Top(remote)",key_int);
+            AUTO_TRACE("DistributedPriorityQueue::Top(remote)",key_int);
             return rpc->call(key_int,func_prefix+"_Pop").template as<std::pair<bool, MappedType>>();
         }
     }
@@ -199,12 +199,12 @@ public:
      */
     size_t Size(uint16_t key_int) {
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedPriorityQueue::Size(local)",key_int);
+            AUTO_TRACE("DistributedPriorityQueue::Size(local)",key_int);
             bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
             size_t value= queue->size();
             return value;
         } else {
-            AutoTrace trace = AutoTrace("DistributedPriorityQueue::Top(remote)",key_int);
+            AUTO_TRACE("DistributedPriorityQueue::Top(remote)",key_int);
             return rpc->call(key_int,func_prefix+"_Size").template as<size_t>();;
         }
     }
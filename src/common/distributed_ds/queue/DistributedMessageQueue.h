@@ -43,9 +43,12 @@
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/algorithm/string.hpp>
 #include <src/common/constants.h>
 #include <src/common/distributed_ds/communication/rpc_lib.h>
+#include <src/common/distributed_ds/growable_segment.h>
 #include <src/common/singleton.h>
 
 /** Namespaces Uses **/
@@ -69,24 +72,29 @@ private:
     std::shared_ptr<RPC> rpc;
     really_long memory_allocated;
     bool is_server;
-    boost::interprocess::managed_shared_memory segment;
+    GrowableSegment segment;
     std::string name,func_prefix;
     Queue *queue;
     boost::interprocess::interprocess_mutex* mutex;
-public:
-    /* Constructor to deallocate the shared memory*/
-    ~DistributedMessageQueue(){
-        if(is_server) bip::shared_memory_object::remove(name.c_str());
+    boost::interprocess::interprocess_condition* not_empty;
+
+    /* find the queue, its lock and condition in a (re)mapped segment */
+    void Attach(bip::managed_shared_memory &shm){
+        queue = shm.find<Queue>("Queue").first;
+        mutex = shm.find<bip::interprocess_mutex>("mtx").first;
+        not_empty = shm.find<bip::interprocess_condition>("cond").first;
     }
+public:
 
     explicit DistributedMessageQueue(std::string name_,
                                      bool is_server_,
                                      uint16_t my_server_,
-                                     int num_servers_)
+                                     int num_servers_,
+                                     really_long memory_allocated_ = SHM_SEGMENT_INITIAL_SIZE)
             : is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
-              comm_size(1), my_rank(0), memory_allocated(1024ULL * 1024ULL * 128ULL), name(name_), segment(),
+              comm_size(1), my_rank(0), memory_allocated(memory_allocated_), name(name_), segment(),
               queue(),func_prefix(name_){
-        AutoTrace trace = AutoTrace("DistributedMessageQueue(local)",name_,is_server_,my_server_,num_servers_);
+        AUTO_TRACE("DistributedMessageQueue(local)",name_,is_server_,my_server_,num_servers_);
         /* Initialize MPI rank and size of world */
         MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
         MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
@@ -94,35 +102,31 @@ public:
         this->name += "_" + std::to_string(my_server);
         rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
         if (is_server) {
-            /* Delete existing instance of shared memory space*/
-            bip::shared_memory_object::remove(name.c_str());
-            /* allocate new shared memory space */
-            segment=bip::managed_shared_memory(bip::create_only,name.c_str(),memory_allocated);
-            ShmemAllocator alloc_inst (segment.get_segment_manager());
+            /* allocate new shared memory space, replacing any existing one. It grows with the data. */
+            segment.Create(name,memory_allocated,std::bind(&DistributedMessageQueue<MappedType>::Attach, this, std::placeholders::_1));
+            bip::managed_shared_memory &shm = segment.Get();
+            ShmemAllocator alloc_inst (shm.get_segment_manager());
             /* Construct Hashmap in the shared memory space. */
-            queue = segment.construct<Queue>("Queue")(alloc_inst);
-            mutex = segment.construct<bip::interprocess_mutex>("mtx")();
+            queue = shm.construct<Queue>("Queue")(alloc_inst);
+            mutex = shm.construct<bip::interprocess_mutex>("mtx")();
+            not_empty = shm.construct<bip::interprocess_condition>("cond")();
             /* Create a RPC server and map the methods to it. */
             std::function<bool(MappedType,uint16_t)> pushFunc(std::bind(&DistributedMessageQueue<MappedType>::Push, this, std::placeholders::_1, std::placeholders::_2));
             std::function<std::pair<bool,MappedType>(uint16_t)> popFunc(std::bind(&DistributedMessageQueue::Pop, this, std::placeholders::_1));
             std::function<size_t(uint16_t)> sizeFunc(std::bind(&DistributedMessageQueue::Size, this, std::placeholders::_1));
             std::function<bool(uint16_t)> waitForElementFunc(std::bind(&DistributedMessageQueue::WaitForElement, this, std::placeholders::_1));
+            std::function<std::vector<MappedType>(uint16_t,size_t,long,long)> popBatchFunc(std::bind(&DistributedMessageQueue::PopBatch, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
             rpc->bind(func_prefix+"_Push", pushFunc);
             rpc->bind(func_prefix+"_Pop", popFunc);
             rpc->bind(func_prefix+"_WaitForElement", waitForElementFunc);
             rpc->bind(func_prefix+"_Size", sizeFunc);
+            rpc->bind(func_prefix+"_PopBatch", popBatchFunc);
         }
         /* Make clients wait untill all servers reach here*/
         MPI_Barrier(MPI_COMM_WORLD);
         /* Map the clients to their respective memory pools */
         if(!is_server){
-            segment=bip::managed_shared_memory(bip::open_only,name.c_str());
-            std::pair<Queue*, bip::managed_shared_memory::size_type> res;
-            res = segment.find<Queue> ("Queue");
-            queue = res.first;
-            std::pair<bip::interprocess_mutex *, bip::managed_shared_memory::size_type> res2;
-            res2 = segment.find<bip::interprocess_mutex>("mtx");
-            mutex = res2.first;
+            segment.Open(name,std::bind(&DistributedMessageQueue<MappedType>::Attach, this, std::placeholders::_1));
         }
         MPI_Barrier(MPI_COMM_WORLD);
     }
@@ -134,12 +138,15 @@ public:
      */
     bool Push(MappedType data, uint16_t key_int){
         if(key_int == my_server){
-            AutoTrace trace = AutoTrace("DistributedMessageQueue::Push(local)",data, key_int);
-            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
-            queue->push_back(std::move(data));
-            return true;
+            AUTO_TRACE("DistributedMessageQueue::Push(local)",data, key_int);
+            return segment.Run([&]() -> bool {
+                bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+                queue->push_back(data);
+                not_empty->notify_one();
+                return true;
+            });
         }else{
-            AutoTrace trace = AutoTrace("DistributedMessageQueue::Push(remote)",data, key_int);
+            AUTO_TRACE("DistributedMessageQueue::Push(remote)",data, key_int);
             return rpc->call(key_int,func_prefix+"_Push", data).template as<bool>();
         }
     }
@@ -151,32 +158,80 @@ public:
      */
     std::pair<bool,MappedType> Pop(uint16_t key_int) {
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedMessageQueue::Pop(local)", key_int);
-            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
-            if(queue->size()>0){
-                MappedType value = queue->front();
-                queue->pop_front();
-                return std::pair<bool,MappedType>(true,value);
-            }
-            return std::pair<bool,MappedType>(false,MappedType());;
+            AUTO_TRACE("DistributedMessageQueue::Pop(local)", key_int);
+            return segment.Run([&]() -> std::pair<bool,MappedType> {
+                bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+                if(queue->size()>0){
+                    MappedType value = queue->front();
+                    queue->pop_front();
+                    return std::pair<bool,MappedType>(true,value);
+                }
+                return std::pair<bool,MappedType>(false,MappedType());
+            });
         } else {
-            AutoTrace trace = AutoTrace("DistributedMessageQueue::Pop(remote)", key_int);
+            AUTO_TRACE("DistributedMessageQueue::Pop(remote)", key_int);
             return rpc->call(key_int,func_prefix+"_Pop").template as<std::pair<bool, MappedType>>();
         }
     }
 
+    /**
+     * Drain a batch of elements from the queue. Uses key_int to decide the server to hash it to,
+     * Blocks up to timeout_us for the first element and then keeps collecting until max_elements
+     * are drained or window_us has passed since the first element was taken.
+     * @param key_int, key_int to know which server
+     * @param max_elements, maximum number of elements to return
+     * @param window_us, time to wait for more elements once the batch is started
+     * @param timeout_us, time to wait for the first element
+     * @return the drained elements, empty if none arrived before timeout_us
+     */
+    std::vector<MappedType> PopBatch(uint16_t key_int, size_t max_elements, long window_us, long timeout_us) {
+        if (key_int == my_server) {
+            AUTO_TRACE("DistributedMessageQueue::PopBatch(local)", key_int, max_elements);
+            std::vector<MappedType> values = std::vector<MappedType>();
+            auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds(timeout_us);
+            bool batch_started = false;
+            /* popping never allocates in the segment, so the whole batch is one operation */
+            segment.Run([&]() -> void {
+                bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+                while(values.size() < max_elements){
+                    while(queue->size() == 0){
+                        if(!not_empty->timed_wait(lock, deadline) && queue->size() == 0) return;
+                    }
+                    while(queue->size() > 0 && values.size() < max_elements){
+                        values.push_back(queue->front());
+                        queue->pop_front();
+                    }
+                    if(!batch_started){
+                        /* first element taken: give the batch at most window_us to fill up */
+                        batch_started = true;
+                        deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds(window_us);
+                    }
+                }
+            });
+            return values;
+        } else {
+            AUTO_TRACE("DistributedMessageQueue::PopBatch(remote)", key_int, max_elements);
+            return rpc->call(key_int,func_prefix+"_PopBatch",key_int,max_elements,window_us,timeout_us).template as<std::vector<MappedType>>();
+        }
+    }
+
     bool WaitForElement(uint16_t key_int) {
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedMessageQueue::WaitForElement(local)", key_int);
-            int count=0;
-            while(queue->size()==0){
-                usleep(10);
-                if(count==0) printf("Server %d, No Events in Queue\n",key_int);
-                count++;
-            }
+            AUTO_TRACE("DistributedMessageQueue::WaitForElement(local)", key_int);
+            bool reported = false;
+            /* wait in slices so that a growth of the segment is never held off for long */
+            while(!segment.Run([&]() -> bool {
+                bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+                if(queue->size()==0 && !reported) printf("Server %d, No Events in Queue\n",key_int);
+                reported = true;
+                if(queue->size()==0){
+                    not_empty->timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(QUEUE_WAIT_SLICE_MS));
+                }
+                return queue->size()>0;
+            })){}
             return true;
         } else {
-            AutoTrace trace = AutoTrace("DistributedMessageQueue::WaitForElement(remote)", key_int);
+            AUTO_TRACE("DistributedMessageQueue::WaitForElement(remote)", key_int);
             return rpc->call(key_int,func_prefix+"_WaitForElement").template as<bool>();
         }
     }
@@ -188,11 +243,12 @@ public:
      */
     size_t Size(uint16_t key_int) {
         if (key_int == my_server) {
-            AutoTrace trace = AutoTrace("DistributedMessageQueue::Size(local)", key_int);
-            size_t value= queue->size();
-            return value;
+            AUTO_TRACE("DistributedMessageQueue::Size(local)", key_int);
+            return segment.Run([&]() -> size_t {
+                return queue->size();
+            });
         } else {
-            AutoTrace trace = AutoTrace("DistributedMessageQueue::Size(remote)", key_int);
+            AUTO_TRACE("DistributedMessageQueue::Size(remote)", key_int);
             return rpc->call(key_int,func_prefix+"_Size").template as<size_t>();;
         }
     }
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_EVENT_RING_H
+#define HFETCH_EVENT_RING_H
+
+/**
+ * Include Headers
+ */
+/** Standard C++ Headers**/
+#include <atomic>
+#include <climits>
+#include <ctime>
+#include <vector>
+/** Linux Headers**/
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+/** MPI Headers**/
+#include <mpi.h>
+/** Boost Headers **/
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <src/common/constants.h>
+#include <src/common/data_structure.h>
+#include <src/common/debug.h>
+
+/** Namespaces Uses **/
+namespace bip=boost::interprocess;
+
+/**
+ * Node local event submission rings. Every client rank of a server owns one bounded single producer single
+ * consumer ring in shared memory, so submitting an event never takes a lock. Server worker i drains the rings
+ * with ring % num_workers == i and sleeps on a futex doorbell when all of them are empty.
+ * Adjacent reads of the same file are coalesced into the last event the worker has not taken yet.
+ */
+class EventRing {
+private:
+    enum SlotState { EMPTY=0, READY=1, WRITING=2, TAKEN=3 };
+    /* one event and its hand-off state between the producer and the consumer */
+    struct Slot{
+        std::atomic<int> state;
+        Event event;
+        Slot():state(EMPTY),event(){}
+    };
+    /* head is only written by the consumer and tail by the producer, keep them on separate cache lines */
+    struct Ring{
+        std::atomic<uint64_t> head;
+        char head_pad[64-sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> tail;
+        char tail_pad[64-sizeof(std::atomic<uint64_t>)];
+        Ring():head(0),tail(0){}
+    };
+    struct Doorbell{
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint32_t> waiters;
+        char pad[64-2*sizeof(std::atomic<uint32_t>)];
+        Doorbell():sequence(0),waiters(0){}
+    };
+
+    /** Class attributes**/
+    bool is_server;
+    uint16_t my_server;
+    int my_ring,num_rings;
+    size_t ring_size;
+    bip::managed_shared_memory segment;
+    std::string name;
+    Ring* rings;
+    Slot* slots;
+    Doorbell* doorbells;
+    std::atomic<int>* num_workers;
+
+    static long Futex(std::atomic<uint32_t>* address, int operation, uint32_t value, const struct timespec* timeout){
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), operation, value, timeout, nullptr, 0);
+    }
+
+    Doorbell* GetDoorbell(int ring){
+        return &doorbells[ring % num_workers->load(std::memory_order_relaxed)];
+    }
+
+    static bool Coalesce(Event &last, const Event &event){
+        if(last.event_type != EventType::FILE_READ || event.event_type != EventType::FILE_READ) return false;
+        if(last.segment.end + 1 != event.segment.start || last.file_id != event.file_id) return false;
+        last.segment.end = event.segment.end;
+        last.time = event.time;
+        return true;
+    }
+public:
+    ~EventRing(){
+        AUTO_TRACE("~EventRing");
+        if(is_server) bip::shared_memory_object::remove(name.c_str());
+    }
+
+    /**
+     * @param name_, name of the shared memory segment
+     * @param is_server_, true for the server which creates the rings
+     * @param my_server_, server to which the rings belong
+     * @param num_rings_, number of client ranks per server
+     * @param my_ring_, ring owned by this client rank, ignored on the server
+     */
+    EventRing(std::string name_, bool is_server_, uint16_t my_server_, int num_rings_, int my_ring_)
+            : is_server(is_server_), my_server(my_server_), my_ring(my_ring_), num_rings(num_rings_),
+              ring_size(EVENT_RING_SIZE), segment(), name(name_){
+        AUTO_TRACE("EventRing",name_,is_server_,my_server_,num_rings_,my_ring_);
+        name += "_" + std::to_string(my_server);
+        if(is_server){
+            bip::shared_memory_object::remove(name.c_str());
+            size_t memory_allocated = num_rings*(sizeof(Ring)+ring_size*sizeof(Slot))
+                                      + MAX_EVENT_WORKERS*sizeof(Doorbell) + 1024ULL*1024ULL;
+            segment = bip::managed_shared_memory(bip::create_only, name.c_str(), memory_allocated);
+            rings = segment.construct<Ring>("Rings")[num_rings]();
+            slots = segment.construct<Slot>("Slots")[num_rings*ring_size]();
+            doorbells = segment.construct<Doorbell>("Doorbells")[MAX_EVENT_WORKERS]();
+            num_workers = segment.construct<std::atomic<int>>("Workers")(1);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if(!is_server){
+            segment = bip::managed_shared_memory(bip::open_only, name.c_str());
+            rings = segment.find<Ring>("Rings").first;
+            slots = segment.find<Slot>("Slots").first;
+            doorbells = segment.find<Doorbell>("Doorbells").first;
+            num_workers = segment.find<std::atomic<int>>("Workers").first;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    /**
+     * Set the number of server workers draining the rings.
+     */
+    void SetWorkers(int workers){
+        AUTO_TRACE("EventRing::SetWorkers",workers);
+        if(workers > MAX_EVENT_WORKERS) workers = MAX_EVENT_WORKERS;
+        if(workers < 1) workers = 1;
+        num_workers->store(workers);
+    }
+
+    /**
+     * Submit an event on the ring of this rank. Never blocks.
+     * @return false if the ring is full and the event was not taken.
+     */
+    bool Push(const Event &event){
+        Ring &ring = rings[my_ring];
+        Slot* ring_slots = slots + my_ring*ring_size;
+        uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        if(tail != head){
+            /* the last event is still queued: try to extend it instead of using a new slot */
+            Slot &last = ring_slots[(tail-1) % ring_size];
+            int expected = READY;
+            if(last.state.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)){
+                bool merged = Coalesce(last.event, event);
+                last.state.store(READY, std::memory_order_release);
+                if(merged) return true;
+            }
+        }
+        if(tail - head >= ring_size) return false;
+        Slot &slot = ring_slots[tail % ring_size];
+        slot.event = event;
+        slot.state.store(READY, std::memory_order_release);
+        ring.tail.store(tail+1, std::memory_order_release);
+        Notify();
+        return true;
+    }
+
+    /**
+     * Wake the worker responsible for the ring of this rank.
+     */
+    void Notify(){
+        Doorbell* doorbell = GetDoorbell(my_ring);
+        doorbell->sequence.fetch_add(1);
+        if(doorbell->waiters.load() > 0) Futex(&doorbell->sequence, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+
+    /**
+     * Current doorbell value of a worker. Read it before Drain and pass it to Wait.
+     */
+    uint32_t Sequence(int worker){
+        return doorbells[worker].sequence.load();
+    }
+
+    /**
+     * Sleep until a producer rings the doorbell of the worker after sequence was read or timeout_us passes.
+     */
+    void Wait(int worker, uint32_t sequence, long timeout_us){
+        if(timeout_us <= 0) return;
+        Doorbell &doorbell = doorbells[worker];
+        struct timespec timeout = {timeout_us / 1000000, (timeout_us % 1000000) * 1000};
+        doorbell.waiters.fetch_add(1);
+        Futex(&doorbell.sequence, FUTEX_WAIT, sequence, &timeout);
+        doorbell.waiters.fetch_sub(1);
+    }
+
+    /**
+     * Move up to max_elements events from the rings of a worker into events.
+     * @return number of events taken
+     */
+    size_t Drain(int worker, size_t max_elements, std::vector<Event> &events){
+        size_t taken = 0;
+        int workers = num_workers->load(std::memory_order_relaxed);
+        for(int i = worker; i < num_rings && taken < max_elements; i += workers){
+            Ring &ring = rings[i];
+            Slot* ring_slots = slots + i*ring_size;
+            uint64_t head = ring.head.load(std::memory_order_relaxed);
+            uint64_t tail = ring.tail.load(std::memory_order_acquire);
+            while(head != tail && taken < max_elements){
+                Slot &slot = ring_slots[head % ring_size];
+                int expected = READY;
+                /* the producer may be coalescing into this slot, it only holds it for a copy */
+                while(!slot.state.compare_exchange_weak(expected, TAKEN, std::memory_order_acquire)) expected = READY;
+                events.push_back(slot.event);
+                slot.state.store(EMPTY, std::memory_order_relaxed);
+                ring.head.store(++head, std::memory_order_release);
+                taken++;
+            }
+        }
+        return taken;
+    }
+
+    /**
+     * Number of events queued across all rings.
+     */
+    size_t Size(){
+        size_t size = 0;
+        for(int i = 0; i < num_rings; ++i){
+            size += rings[i].tail.load() - rings[i].head.load();
+        }
+        return size;
+    }
+};
+
+#endif //HFETCH_EVENT_RING_H
@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_DISTRIBUTEDSCOREINDEX_H
+#define HFETCH_DISTRIBUTEDSCOREINDEX_H
+
+/**
+ * Include Headers
+ */
+/** Standard C++ Headers**/
+#include <iostream>
+#include <functional>
+#include <limits>
+#include <utility>
+/** MPI Headers**/
+#include <mpi.h>
+/** RPC Lib Headers**/
+#include "../../../../external/rpclib/include/rpc/server.h"
+#include "../../../../external/rpclib/include/rpc/client.h"
+/** Boost Headers **/
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/containers/map.hpp>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <src/common/constants.h>
+#include <src/common/distributed_ds/communication/rpc_lib.h>
+#include <src/common/singleton.h>
+#include <src/common/macros.h>
+
+/** Namespaces Uses **/
+namespace bip=boost::interprocess;
+
+/**
+ * This is a Distributed Score Index Class. It keeps values ordered by a score on one owner server and
+ * supports updating the score of a single key in place. It uses shared memory + RPC + MPI to achieve the
+ * data structure.
+ *
+ * @tparam KeyType, unique key of a value
+ * @tparam MappedType, the value, must provide GetSize() for the Lowest and Claim queries and GetServer() for Claim
+ */
+template<typename KeyType, typename MappedType>
+class DistributedScoreIndex {
+private:
+    /** Class Typedefs for ease of use **/
+    typedef std::pair<KeyType,MappedType> EntryType;
+    typedef std::pair<const double, EntryType> ScoreValueType;
+    typedef bip::allocator<ScoreValueType, bip::managed_shared_memory::segment_manager> ScoreAllocator;
+    typedef bip::multimap<double, EntryType, std::less<double>, ScoreAllocator> ScoreMap;
+    typedef std::pair<const KeyType, double> KeyValueType;
+    typedef bip::allocator<KeyValueType, bip::managed_shared_memory::segment_manager> KeyAllocator;
+    typedef bip::map<KeyType, double, std::less<KeyType>, KeyAllocator> KeyMap;
+
+    /** Class attributes**/
+    int comm_size, my_rank,num_servers;
+    uint16_t  my_server,owner;
+    std::shared_ptr<RPC> rpc;
+    really_long memory_allocated;
+    bool is_server;
+    bip::managed_shared_memory segment;
+    std::string name,func_prefix;
+    ScoreMap *scores;
+    KeyMap *keys;
+    bip::interprocess_mutex* mutex;
+
+    /* remove key from both maps, the caller holds the mutex */
+    bool RemoveLocked(const KeyType &key){
+        typename KeyMap::iterator key_iter = keys->find(key);
+        if(key_iter == keys->end()) return false;
+        auto range = scores->equal_range(key_iter->second);
+        for(auto iter = range.first; iter != range.second; ++iter){
+            if(iter->second.first == key){
+                scores->erase(iter);
+                break;
+            }
+        }
+        keys->erase(key_iter);
+        return true;
+    }
+public:
+    /* Constructor to deallocate the shared memory*/
+    ~DistributedScoreIndex(){
+        if(is_server) bip::shared_memory_object::remove(name.c_str());
+    }
+
+    explicit DistributedScoreIndex(std::string name_,
+                                   bool is_server_,
+                                   uint16_t my_server_,
+                                   int num_servers_,
+                                   uint16_t owner_)
+            : is_server(is_server_), my_server(my_server_), num_servers(num_servers_), owner(owner_),
+              comm_size(1), my_rank(0), memory_allocated(1024ULL * 1024ULL * 128ULL), name(name_), segment(),
+              scores(), keys(), func_prefix(name_){
+        AUTO_TRACE("DistributedScoreIndex",name_,is_server_,my_server_,num_servers_,owner_);
+        /* Initialize MPI rank and size of world */
+        MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+        MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+        /* create per server name for shared memory. Needed if multiple servers are spawned on one node*/
+        this->name += "_" + std::to_string(my_server);
+        rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
+        if (is_server) {
+            /* Delete existing instance of shared memory space*/
+            bip::shared_memory_object::remove(name.c_str());
+            /* allocate new shared memory space */
+            segment=bip::managed_shared_memory(bip::create_only,name.c_str(),memory_allocated);
+            ScoreAllocator score_alloc(segment.get_segment_manager());
+            KeyAllocator key_alloc(segment.get_segment_manager());
+            /* Construct the index in the shared memory space. */
+            scores = segment.construct<ScoreMap>("Scores")(std::less<double>(),score_alloc);
+            keys = segment.construct<KeyMap>("Keys")(std::less<KeyType>(),key_alloc);
+            mutex = segment.construct<bip::interprocess_mutex>("mtx")();
+            /* Create a RPC server and map the methods to it. */
+            std::function<bool(KeyType,double,MappedType)> insertFunc(std::bind(&DistributedScoreIndex::Insert, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            std::function<bool(KeyType)> removeFunc(std::bind(&DistributedScoreIndex::Remove, this, std::placeholders::_1));
+            std::function<bool(KeyType,double)> updateScoreFunc(std::bind(&DistributedScoreIndex::UpdateScore, this, std::placeholders::_1, std::placeholders::_2));
+            std::function<std::pair<bool,double>(void)> minFunc(std::bind(&DistributedScoreIndex::Min, this));
+            std::function<std::pair<bool,double>(void)> maxFunc(std::bind(&DistributedScoreIndex::Max, this));
+            std::function<std::vector<std::pair<double,MappedType>>(double,long)> lowestFunc(std::bind(&DistributedScoreIndex::Lowest, this, std::placeholders::_1, std::placeholders::_2));
+            std::function<bool(KeyType,double,MappedType)> restoreFunc(std::bind(&DistributedScoreIndex::Restore, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            std::function<std::vector<std::pair<double,EntryType>>(double,long,uint16_t)> claimFunc(std::bind(&DistributedScoreIndex::Claim, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            std::function<size_t(void)> sizeFunc(std::bind(&DistributedScoreIndex::Size, this));
+            rpc->bind(func_prefix+"_Insert", insertFunc);
+            rpc->bind(func_prefix+"_Remove", removeFunc);
+            rpc->bind(func_prefix+"_UpdateScore", updateScoreFunc);
+            rpc->bind(func_prefix+"_Min", minFunc);
+            rpc->bind(func_prefix+"_Max", maxFunc);
+            rpc->bind(func_prefix+"_Lowest", lowestFunc);
+            rpc->bind(func_prefix+"_Restore", restoreFunc);
+            rpc->bind(func_prefix+"_Claim", claimFunc);
+            rpc->bind(func_prefix+"_Size", sizeFunc);
+        }
+        /* Make clients wait untill all servers reach here*/
+        MPI_Barrier(MPI_COMM_WORLD);
+        /* Map the clients to their respective memory pools */
+        if(!is_server){
+            segment=bip::managed_shared_memory(bip::open_only,name.c_str());
+            scores = segment.find<ScoreMap>("Scores").first;
+            keys = segment.find<KeyMap>("Keys").first;
+            mutex = segment.find<bip::interprocess_mutex>("mtx").first;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    /**
+     * Insert a value with a score, replacing the previous entry of the key.
+     * @return bool, true if Insert was successful else false.
+     */
+    bool Insert(KeyType key, double score, MappedType data){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::Insert(local)",key,score,data);
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            RemoveLocked(key);
+            scores->insert(std::pair<double,EntryType>(score,EntryType(key,data)));
+            keys->insert(std::pair<KeyType,double>(key,score));
+            return true;
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::Insert(remote)",key,score,data);
+            return rpc->call(owner,func_prefix+"_Insert",key,score,data).template as<bool>();
+        }
+    }
+
+    /**
+     * Remove the entry of a key.
+     * @return bool, true if the key was present.
+     */
+    bool Remove(KeyType key){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::Remove(local)",key);
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            return RemoveLocked(key);
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::Remove(remote)",key);
+            return rpc->call(owner,func_prefix+"_Remove",key).template as<bool>();
+        }
+    }
+
+    /**
+     * Move the entry of a key to a new score, keeping its value.
+     * @return bool, true if the key was present.
+     */
+    bool UpdateScore(KeyType key, double score){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::UpdateScore(local)",key,score);
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            typename KeyMap::iterator key_iter = keys->find(key);
+            if(key_iter == keys->end()) return false;
+            auto range = scores->equal_range(key_iter->second);
+            for(auto iter = range.first; iter != range.second; ++iter){
+                if(iter->second.first == key){
+                    EntryType entry = iter->second;
+                    scores->erase(iter);
+                    scores->insert(std::pair<double,EntryType>(score,entry));
+                    key_iter->second = score;
+                    return true;
+                }
+            }
+            return false;
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::UpdateScore(remote)",key,score);
+            return rpc->call(owner,func_prefix+"_UpdateScore",key,score).template as<bool>();
+        }
+    }
+
+    /**
+     * @return pair of bool and the lowest score. bool is false if the index is empty.
+     */
+    std::pair<bool,double> Min(){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::Min(local)");
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            if(scores->empty()) return std::pair<bool,double>(false,0);
+            return std::pair<bool,double>(true,scores->begin()->first);
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::Min(remote)");
+            return rpc->call(owner,func_prefix+"_Min").template as<std::pair<bool,double>>();
+        }
+    }
+
+    /**
+     * @return pair of bool and the highest score. bool is false if the index is empty.
+     */
+    std::pair<bool,double> Max(){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::Max(local)");
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            if(scores->empty()) return std::pair<bool,double>(false,0);
+            return std::pair<bool,double>(true,scores->rbegin()->first);
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::Max(remote)");
+            return rpc->call(owner,func_prefix+"_Max").template as<std::pair<bool,double>>();
+        }
+    }
+
+    /**
+     * Lowest scored values, in ascending score, with a score below below_score until bytes are covered.
+     * @param below_score, only values with a smaller score are returned
+     * @param bytes, stop once the returned values add up to at least this size
+     * @return score and value pairs
+     */
+    std::vector<std::pair<double,MappedType>> Lowest(double below_score, long bytes){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::Lowest(local)",below_score,bytes);
+            std::vector<std::pair<double,MappedType>> values = std::vector<std::pair<double,MappedType>>();
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            long collected = 0;
+            for(auto iter = scores->begin(); iter != scores->end() && iter->first < below_score && collected < bytes; ++iter){
+                values.push_back(std::pair<double,MappedType>(iter->first,iter->second.second));
+                collected += iter->second.second.GetSize();
+            }
+            return values;
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::Lowest(remote)",below_score,bytes);
+            return rpc->call(owner,func_prefix+"_Lowest",below_score,bytes).template as<std::vector<std::pair<double,MappedType>>>();
+        }
+    }
+
+    /**
+     * Put back an entry returned by Claim, unless its key was inserted again in the meantime.
+     * @return bool, true if the entry was put back.
+     */
+    bool Restore(KeyType key, double score, MappedType data){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::Restore(local)",key,score,data);
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            if(keys->find(key) != keys->end()) return false;
+            scores->insert(std::pair<double,EntryType>(score,EntryType(key,data)));
+            keys->insert(std::pair<KeyType,double>(key,score));
+            return true;
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::Restore(remote)",key,score,data);
+            return rpc->call(owner,func_prefix+"_Restore",key,score,data).template as<bool>();
+        }
+    }
+
+    /**
+     * Remove and return the lowest scored entries held by server, in ascending score, with a score below
+     * below_score until bytes are covered. Claimed entries leave the index, so concurrent callers never
+     * act on the same entry; the caller puts back the ones it could not use with Restore.
+     * @param below_score, only entries with a smaller score are claimed
+     * @param bytes, stop once the claimed values add up to at least this size
+     * @param server, only values whose GetServer() is this server are claimed
+     * @return score and entry pairs
+     */
+    std::vector<std::pair<double,EntryType>> Claim(double below_score, long bytes, uint16_t server){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::Claim(local)",below_score,bytes,server);
+            std::vector<std::pair<double,EntryType>> entries = std::vector<std::pair<double,EntryType>>();
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            long collected = 0;
+            auto iter = scores->begin();
+            while(iter != scores->end() && iter->first < below_score && collected < bytes){
+                if(iter->second.second.GetServer() != server){
+                    ++iter;
+                    continue;
+                }
+                entries.push_back(std::pair<double,EntryType>(iter->first,EntryType(iter->second.first,iter->second.second)));
+                collected += iter->second.second.GetSize();
+                keys->erase(iter->second.first);
+                iter = scores->erase(iter);
+            }
+            return entries;
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::Claim(remote)",below_score,bytes,server);
+            return rpc->call(owner,func_prefix+"_Claim",below_score,bytes,server).template as<std::vector<std::pair<double,EntryType>>>();
+        }
+    }
+
+    size_t Size(){
+        if(owner == my_server){
+            AUTO_TRACE("DistributedScoreIndex::Size(local)");
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            return scores->size();
+        }else{
+            AUTO_TRACE("DistributedScoreIndex::Size(remote)");
+            return rpc->call(owner,func_prefix+"_Size").template as<size_t>();
+        }
+    }
+};
+
+#endif //HFETCH_DISTRIBUTEDSCOREINDEX_H
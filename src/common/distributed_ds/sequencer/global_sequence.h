@@ -26,27 +26,42 @@
 #define HERMES_PROJECT_GLOBAL_SEQUENCE_H
 
 #include <stdint-gcc.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <mpi.h>
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
-#include <boost/interprocess/sync/interprocess_mutex.hpp>
-#include <boost/interprocess/sync/scoped_lock.hpp>
 #include <src/common/distributed_ds/communication/rpc_lib.h>
 #include <src/common/singleton.h>
 
 namespace bip=boost::interprocess;
 
+/**
+ * Cluster wide sequence kept by one server. Besides single values it leases blocks of ids, which
+ * a process then hands out with an atomic increment, so unique ids cost one RPC per block.
+ */
 class GlobalSequence{
 private:
-    uint64_t* value;
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,"the shared sequence needs lock free 64 bit atomics");
+    /* block of ids leased by this process, next reaches end once it is used up */
+    typedef struct Lease{
+        std::atomic<uint64_t> next;
+        uint64_t end;
+        Lease(uint64_t start_, uint64_t end_):next(start_),end(end_){}
+    } Lease;
+    /* lock free so that every process mapping the segment updates it with plain atomics */
+    std::atomic<uint64_t>* value;
     bool is_server;
-    bip::interprocess_mutex* mutex;
     int my_rank,comm_size,num_servers;
     uint16_t my_server;
     really_long memory_allocated;
     bip::managed_shared_memory segment;
     std::string name,func_prefix;
     std::shared_ptr<RPC> rpc;
+    uint64_t lease_size;
+    std::shared_ptr<Lease> lease;
+    std::mutex lease_mutex;
 public:
     ~GlobalSequence(){
         if(is_server) bip::shared_memory_object::remove(name.c_str());
@@ -54,48 +69,71 @@ public:
     GlobalSequence(std::string name_,
                    bool is_server_,
                    uint16_t my_server_,
-                   int num_servers_)
+                   int num_servers_,
+                   uint64_t lease_size_=SEQUENCE_LEASE_SIZE)
             : is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
-              comm_size(1), my_rank(0), memory_allocated(1024ULL * 1024ULL * 128ULL), name(name_), segment(),func_prefix(name_){
-        AutoTrace trace = AutoTrace("GlobalSequence", name_,is_server_,my_server_,num_servers_);
+              comm_size(1), my_rank(0), memory_allocated(1024ULL * 1024ULL * 128ULL), name(name_), segment(),func_prefix(name_),
+              lease_size(lease_size_ > 0 ? lease_size_ : 1), lease(std::make_shared<Lease>(0,0)), lease_mutex(){
+        AUTO_TRACE("GlobalSequence", name_,is_server_,my_server_,num_servers_);
         MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
         MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
         name=name+"_"+std::to_string(my_server);
         rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
         if(is_server){
             std::function<uint64_t(void)> getNextSequence(std::bind(&GlobalSequence::GetNextSequence, this));
+            std::function<uint64_t(uint64_t)> getNextBlock(std::bind(&GlobalSequence::GetNextBlock, this, std::placeholders::_1));
             rpc->bind(func_prefix+"_GetNextSequence",getNextSequence);
+            rpc->bind(func_prefix+"_GetNextBlock",getNextBlock);
             bip::shared_memory_object::remove(name.c_str());
             segment=bip::managed_shared_memory(bip::create_only, name.c_str(), 65536);
-            value = segment.construct<uint64_t>(name.c_str())(0);
-            mutex = segment.construct<boost::interprocess::interprocess_mutex>("mtx")();
+            value = segment.construct<std::atomic<uint64_t>>(name.c_str())(0);
         }
         MPI_Barrier(MPI_COMM_WORLD);
         if(!is_server){
             segment=bip::managed_shared_memory(bip::open_only,name.c_str());
-            std::pair<uint64_t*,bip::managed_shared_memory::size_type> res;
-            res = segment.find<uint64_t> (name.c_str());
+            std::pair<std::atomic<uint64_t>*,bip::managed_shared_memory::size_type> res;
+            res = segment.find<std::atomic<uint64_t>> (name.c_str());
             value = res.first;
-            std::pair<bip::interprocess_mutex *, bip::managed_shared_memory::size_type> res2;
-            res2 = segment.find<bip::interprocess_mutex>("mtx");
-            mutex = res2.first;
         }
         MPI_Barrier(MPI_COMM_WORLD);
     }
 
     uint64_t GetNextSequence(){
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-        return ++*value;
+        return value->fetch_add(1) + 1;
     }
     uint64_t GetNextSequenceServer(uint16_t server){
         if(my_server==server){
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*mutex);
-            return ++*value;
+            return value->fetch_add(1) + 1;
         }return
         rpc->call(server,func_prefix+"_GetNextSequence").as<uint64_t>();
 
     }
 
+    /* first of count consecutive values taken from the sequence. */
+    uint64_t GetNextBlock(uint64_t count){
+        return value->fetch_add(count) + 1;
+    }
+
+    /**
+     * Get a value of the sequence kept by server that no other caller receives. Values come from
+     * a block leased by this process, which is renewed from server once used up, so they are
+     * unique but only increasing within this process.
+     */
+    uint64_t GetNextSequenceLeased(uint16_t server){
+        while(true){
+            std::shared_ptr<Lease> current = std::atomic_load(&lease);
+            uint64_t next = current->next.fetch_add(1);
+            if(next < current->end) return next;
+            std::lock_guard<std::mutex> lock(lease_mutex);
+            /* another thread may have renewed it while this one waited */
+            if(std::atomic_load(&lease) != current) continue;
+            uint64_t start;
+            if(my_server==server) start = GetNextBlock(lease_size);
+            else start = rpc->call(server,func_prefix+"_GetNextBlock",lease_size).as<uint64_t>();
+            std::atomic_store(&lease,std::make_shared<Lease>(start,start + lease_size));
+        }
+    }
+
 
 };
 
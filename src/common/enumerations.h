@@ -57,7 +57,8 @@ typedef enum EventSource{
 
 /* Enumerates Data Placement Engines */
 typedef enum DataPlacementEngineType{
-    MAX_BW=0
+    MAX_BW=0,
+    READ_AHEAD=1
 } DataPlacementEngineType;
 
 
@@ -65,7 +66,8 @@ typedef enum DataPlacementEngineType{
 typedef enum IOClientType{
     LOCAL_POSIX_FILE=0,
     SIMPLE_MEMORY=1,
-    SHARED_POSIX_FILE=2
+    SHARED_POSIX_FILE=2,
+    URING_LOCAL_FILE=3
 } IOClientType;
 
 /**
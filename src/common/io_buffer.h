@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_IO_BUFFER_H
+#define HFETCH_IO_BUFFER_H
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <src/common/constants.h>
+
+/**
+ * Keeps released IOBuffer blocks per power of two size class, so that the pieces of every move
+ * reuse the same few allocations. Blocks are aligned for O_DIRECT transfers. At most
+ * MAX_POOLED_IO_BYTES are kept idle, further released blocks are freed.
+ */
+class IOBufferPool{
+private:
+    static const size_t SIZE_CLASSES=64;
+    std::vector<char*> free_blocks[SIZE_CLASSES];
+    size_t pooled_bytes; /* capacity of all blocks in free_blocks */
+    std::mutex mutex;
+
+    static size_t GetClass(size_t capacity){
+        size_t size_class = 0;
+        while((MIN_IO_BUFFER_SIZE << size_class) < capacity) size_class++;
+        return size_class;
+    }
+public:
+    IOBufferPool():pooled_bytes(0),mutex(){}
+    ~IOBufferPool(){
+        for(auto &blocks:free_blocks){
+            for(auto block:blocks) free(block);
+        }
+    }
+
+    /* the pool shared by every buffer of the process. */
+    static std::shared_ptr<IOBufferPool> Instance(){
+        static std::shared_ptr<IOBufferPool> pool = std::make_shared<IOBufferPool>();
+        return pool;
+    }
+
+    /* block of at least size bytes, capacity is set to its actual size. */
+    char* Acquire(size_t size, size_t &capacity){
+        size_t size_class = GetClass(size);
+        capacity = MIN_IO_BUFFER_SIZE << size_class;
+        if(capacity <= MAX_POOLED_IO_BUFFER_SIZE){
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!free_blocks[size_class].empty()){
+                char* block = free_blocks[size_class].back();
+                free_blocks[size_class].pop_back();
+                pooled_bytes -= capacity;
+                return block;
+            }
+        }
+        return static_cast<char*>(aligned_alloc(DIRECT_IO_ALIGNMENT,capacity));
+    }
+
+    void Release(char* block, size_t capacity){
+        if(block == nullptr) return;
+        if(capacity <= MAX_POOLED_IO_BUFFER_SIZE){
+            size_t size_class = GetClass(capacity);
+            std::lock_guard<std::mutex> lock(mutex);
+            if(pooled_bytes + capacity <= MAX_POOLED_IO_BYTES){
+                free_blocks[size_class].push_back(block);
+                pooled_bytes += capacity;
+                return;
+            }
+        }
+        free(block);
+    }
+};
+
+/**
+ * Payload of a PosixFile. Copies share one reference counted block taken from the IOBufferPool,
+ * so passing a file between pipeline stages never copies its bytes. The bytes are read through
+ * data() and written only through resize and mutable_data(), which give the buffer a block of its
+ * own first, so a write through one copy never shows in another; unlike std::string the bytes
+ * resize adds are not zeroed.
+ */
+class IOBuffer{
+private:
+    typedef struct Block{
+        char* memory;
+        size_t capacity;
+    } Block;
+    std::shared_ptr<Block> block;
+    size_t length;
+
+    static std::shared_ptr<Block> Allocate(size_t size){
+        auto pool = IOBufferPool::Instance();
+        Block* allocated = new Block();
+        allocated->memory = pool->Acquire(size,allocated->capacity);
+        if(allocated->memory == nullptr){
+            delete allocated;
+            throw std::bad_alloc();
+        }
+        return std::shared_ptr<Block>(allocated,[pool](Block* released){
+            pool->Release(released->memory,released->capacity);
+            delete released;
+        });
+    }
+
+    /* copy the bytes to a block of this buffer only if other buffers share the current one. */
+    void Unshare(){
+        if(block == nullptr || block.use_count() == 1) return;
+        auto copy = Allocate(length > 0 ? length : 1);
+        if(length > 0) memcpy(copy->memory,block->memory,length);
+        block = copy;
+    }
+public:
+    IOBuffer():block(),length(0){}
+    IOBuffer(const char* data_, size_t size_):block(),length(0){
+        resize(size_);
+        if(size_ > 0) memcpy(block->memory,data_,size_);
+    }
+    IOBuffer(const IOBuffer &other) = default;
+    IOBuffer(IOBuffer &&other) noexcept : block(std::move(other.block)),length(other.length){
+        other.length = 0;
+    }
+    IOBuffer &operator=(const IOBuffer &other) = default;
+    IOBuffer &operator=(IOBuffer &&other) noexcept {
+        block = std::move(other.block);
+        length = other.length;
+        other.length = 0;
+        return *this;
+    }
+
+    size_t size() const{
+        return length;
+    }
+    bool empty() const{
+        return length == 0;
+    }
+    const char* data() const{
+        return block != nullptr ? block->memory : nullptr;
+    }
+    const char &operator[](size_t index) const{
+        return block->memory[index];
+    }
+    /* bytes to fill or modify, copied first to a block of this buffer if other buffers share them */
+    char* mutable_data(){
+        Unshare();
+        return block != nullptr ? block->memory : nullptr;
+    }
+
+    /* set the size to size bytes keeping the leading ones, on a block no other buffer shares */
+    void resize(size_t size){
+        if(size == 0){
+            block.reset();
+            length = 0;
+            return;
+        }
+        if(block == nullptr || block.use_count() > 1 || block->capacity < size){
+            auto resized = Allocate(size);
+            if(block != nullptr && length > 0) memcpy(resized->memory,block->memory,std::min(length,size));
+            block = resized;
+        }
+        length = size;
+    }
+    void clear(){
+        resize(0);
+    }
+};
+#endif //HFETCH_IO_BUFFER_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_ALIGNED_BUFFER_POOL_H
+#define HFETCH_ALIGNED_BUFFER_POOL_H
+
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include <src/common/constants.h>
+
+/**
+ * Reusable DIRECT_IO_BUFFER_SIZE buffers aligned to DIRECT_IO_ALIGNMENT, as needed by O_DIRECT
+ * transfers. Up to MAX_POOLED_DIRECT_IO_BUFFERS released buffers are kept for reuse.
+ */
+class AlignedBufferPool{
+private:
+    std::vector<char*> buffers;
+    std::mutex mutex;
+public:
+    AlignedBufferPool():buffers(){}
+    ~AlignedBufferPool(){
+        for(auto buffer:buffers) free(buffer);
+    }
+    /* a buffer of DIRECT_IO_BUFFER_SIZE bytes, nullptr if none can be allocated. */
+    char* Acquire(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!buffers.empty()){
+                char* buffer = buffers.back();
+                buffers.pop_back();
+                return buffer;
+            }
+        }
+        void* buffer = nullptr;
+        if(posix_memalign(&buffer,DIRECT_IO_ALIGNMENT,DIRECT_IO_BUFFER_SIZE) != 0) return nullptr;
+        return static_cast<char*>(buffer);
+    }
+    void Release(char* buffer){
+        if(buffer == nullptr) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(buffers.size() < MAX_POOLED_DIRECT_IO_BUFFERS){
+                buffers.push_back(buffer);
+                return;
+            }
+        }
+        free(buffer);
+    }
+};
+#endif //HFETCH_ALIGNED_BUFFER_POOL_H
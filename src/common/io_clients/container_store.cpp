@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <unistd.h>
+#include "container_store.h"
+
+ContainerStore::ContainerStore(Layer layer_, bool is_server_, uint16_t my_server_, int num_servers_)
+        : layer(layer_), is_server(is_server_), my_server(my_server_), num_servers(num_servers_),
+          container_size(), max_containers(), memory_allocated(1024ULL * 1024ULL * 32ULL), segment(),
+          name("CONTAINER_STORE_"+std::to_string(layer_.id_)), func_prefix(name), handles(), allocator(),
+          containers(), writes(), mutex(), descriptors(), descriptor_mutex(), stop(false){
+    AUTO_TRACE("ContainerStore",layer_,is_server_,my_server_,num_servers_);
+    /* containers of at most CONTAINER_FILE_SIZE that together cover the tier capacity */
+    size_t capacity = Align(static_cast<size_t>(layer.capacity_mb_ * MB));
+    max_containers = std::max<size_t>((capacity + CONTAINER_FILE_SIZE - 1) / CONTAINER_FILE_SIZE, 1);
+    container_size = std::max<size_t>(Align((capacity + max_containers - 1) / max_containers), DIRECT_IO_ALIGNMENT);
+    name=name+"_"+std::to_string(my_server);
+    rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
+    ledger=Singleton<TierLedger>::GetInstance("TIER_LEDGER",is_server_,my_server_,num_servers_);
+    if(is_server){
+        bip::shared_memory_object::remove(name.c_str());
+        segment=bip::managed_shared_memory(bip::create_only, name.c_str(), memory_allocated);
+        handles = segment.construct<HandleTable>("Handles")(std::less<FileId>(), segment.get_segment_manager());
+        segment.construct<FreeExtentList>("Free")(std::less<size_t>(), segment.get_segment_manager());
+        containers = segment.construct<size_t>("Containers")(0);
+        writes = segment.construct<uint64_t>("Writes")(0);
+        mutex = segment.construct<bip::interprocess_mutex>("mtx")();
+        std::function<std::pair<bool,Segment>(FileId)> pinFunc(std::bind(&ContainerStore::PinInServer, this, std::placeholders::_1));
+        std::function<bool(FileId)> unpinFunc(std::bind(&ContainerStore::UnpinInServer, this, std::placeholders::_1));
+        std::function<std::pair<ServerStatus,long>(FileId,long)> reserveFunc(std::bind(&ContainerStore::ReserveInServer, this, std::placeholders::_1, std::placeholders::_2));
+        std::function<ServerStatus(FileId,Segment)> deleteFunc(std::bind(&ContainerStore::DeleteInServer, this, std::placeholders::_1, std::placeholders::_2));
+        rpc->bind(func_prefix+"_Pin", pinFunc);
+        rpc->bind(func_prefix+"_Unpin", unpinFunc);
+        rpc->bind(func_prefix+"_Reserve", reserveFunc);
+        rpc->bind(func_prefix+"_Delete", deleteFunc);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(!is_server){
+        segment=bip::managed_shared_memory(bip::open_only,name.c_str());
+        handles = segment.find<HandleTable>("Handles").first;
+        containers = segment.find<size_t>("Containers").first;
+        writes = segment.find<uint64_t>("Writes").first;
+        mutex = segment.find<bip::interprocess_mutex>("mtx").first;
+    }
+    allocator = ExtentAllocator(segment.find<FreeExtentList>("Free").first, container_size);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(is_server) compactor = std::thread(&ContainerStore::RunCompaction,this);
+}
+
+ContainerStore::~ContainerStore() {
+    if(!is_server) return;
+    {
+        std::lock_guard<std::mutex> lock(compactor_mutex);
+        stop = true;
+    }
+    compactor_signal.notify_one();
+    compactor.join();
+    descriptors.clear();
+    for(size_t index = 0; index < *containers; ++index) unlink(GetContainerPath(my_server,index).c_str());
+    bip::shared_memory_object::remove(name.c_str());
+}
+
+std::shared_ptr<Descriptor> ContainerStore::GetContainer(uint16_t server, size_t index) {
+    std::lock_guard<std::mutex> lock(descriptor_mutex);
+    auto key = std::make_pair(server,index);
+    auto iter = descriptors.find(key);
+    if(iter != descriptors.end()) return iter->second;
+    std::string path = GetContainerPath(server,index);
+    bool direct = layer.direct_io;
+    int fd = direct ? open(path.c_str(),O_RDWR | O_DIRECT) : -1;
+    if(fd < 0){
+        direct = false;
+        fd = open(path.c_str(),O_RDWR);
+    }
+    if(fd < 0) return nullptr;
+    auto descriptor = std::make_shared<Descriptor>(fd,true,direct);
+    descriptors.emplace(key,descriptor);
+    return descriptor;
+}
+
+bool ContainerStore::AddContainer() {
+    size_t index = *containers;
+    if(index >= max_containers) return false;
+    std::string path = GetContainerPath(my_server,index);
+    int fd = open(path.c_str(),O_RDWR | O_CREAT,0664);
+    if(fd < 0) return false;
+    /* file systems without fallocate get a sparse container instead */
+    bool created = fallocate(fd,0,0,container_size) == 0 || ftruncate(fd,container_size) == 0;
+    close(fd);
+    if(!created) return false;
+    ++*containers;
+    allocator.Free(index * container_size,container_size);
+    return true;
+}
+
+bool ContainerStore::AllocateExtent(size_t length, size_t &offset) {
+    if(length > container_size) return false;
+    while(!allocator.Allocate(length,offset)){
+        if(!AddContainer()) return false;
+    }
+    return true;
+}
+
+bool ContainerStore::CopyExtent(size_t from, size_t to, size_t length) {
+    auto input = GetContainer(my_server,from / container_size);
+    auto output = GetContainer(my_server,to / container_size);
+    if(input == nullptr || output == nullptr) return false;
+    loff_t input_offset = from % container_size;
+    loff_t output_offset = to % container_size;
+    size_t remaining = length;
+    while(remaining > 0){
+        ssize_t bytes = copy_file_range(input->fd,&input_offset,output->fd,&output_offset,remaining,0);
+        if(bytes <= 0) break;
+        remaining -= bytes;
+    }
+    if(remaining == 0) return true;
+    /* copy the rest through an aligned buffer, extents are aligned for O_DIRECT containers */
+    char* buffer = static_cast<char*>(aligned_alloc(DIRECT_IO_ALIGNMENT,MOVE_CHUNK_SIZE));
+    if(buffer == nullptr) return false;
+    while(remaining > 0){
+        size_t chunk = std::min(remaining,MOVE_CHUNK_SIZE);
+        if(pread(input->fd,buffer,chunk,input_offset) != static_cast<ssize_t>(chunk) ||
+           pwrite(output->fd,buffer,chunk,output_offset) != static_cast<ssize_t>(chunk)) break;
+        input_offset += chunk;
+        output_offset += chunk;
+        remaining -= chunk;
+    }
+    free(buffer);
+    return remaining == 0;
+}
+
+bool ContainerStore::PunchHole(size_t offset, size_t length) {
+    auto container = GetContainer(my_server,offset / container_size);
+    if(container == nullptr) return false;
+    return fallocate(container->fd,FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,offset % container_size,length) == 0;
+}
+
+std::pair<bool,Segment> ContainerStore::PinInServer(FileId file_id) {
+    AUTO_TRACE("ContainerStore::Pin",file_id);
+    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    auto iter = handles->find(file_id);
+    if(iter == handles->end() || iter->second.deleted) return std::pair<bool,Segment>(false,Segment());
+    iter->second.pins++;
+    return std::pair<bool,Segment>(true,Segment(iter->second.offset,iter->second.offset + iter->second.size - 1));
+}
+
+bool ContainerStore::UnpinInServer(FileId file_id) {
+    AUTO_TRACE("ContainerStore::Unpin",file_id);
+    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    auto iter = handles->find(file_id);
+    if(iter == handles->end() || iter->second.pins == 0) return false;
+    ContainerExtent &extent = iter->second;
+    if(--extent.pins == 0 && extent.deleted){
+        allocator.Free(extent.offset,extent.capacity);
+        ledger->Free(layer,extent.capacity);
+        handles->erase(iter);
+    }
+    return true;
+}
+
+std::pair<ServerStatus,long> ContainerStore::ReserveInServer(FileId file_id, long end) {
+    AUTO_TRACE("ContainerStore::Reserve",file_id,end);
+    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    size_t required = end > 0 ? end : 0;
+    auto iter = handles->find(file_id);
+    if(iter == handles->end()){
+        ContainerExtent extent;
+        extent.capacity = Align(std::max<size_t>(required,1));
+        if(!AllocateExtent(extent.capacity,extent.offset)) return std::pair<ServerStatus,long>(SERVER_FAILED,0);
+        extent.size = required;
+        extent.pins = 1;
+        extent.generation = ++*writes;
+        handles->insert(HandleValue(file_id,extent));
+        ledger->Allocate(layer,extent.capacity);
+        return std::pair<ServerStatus,long>(SERVER_SUCCESS,extent.offset);
+    }
+    ContainerExtent &extent = iter->second;
+    if(extent.deleted) return std::pair<ServerStatus,long>(SERVER_FAILED,0);
+    if(required > extent.capacity){
+        size_t new_capacity = Align(required);
+        if(!allocator.Grow(extent.offset,extent.capacity,new_capacity)){
+            /* relocating would pull the extent from under transfers still using it */
+            if(extent.pins > 0) return std::pair<ServerStatus,long>(SERVER_FAILED,0);
+            size_t new_offset;
+            if(!AllocateExtent(new_capacity,new_offset)) return std::pair<ServerStatus,long>(SERVER_FAILED,0);
+            if(!CopyExtent(extent.offset,new_offset,Align(extent.size))){
+                allocator.Free(new_offset,new_capacity);
+                return std::pair<ServerStatus,long>(SERVER_FAILED,0);
+            }
+            allocator.Free(extent.offset,extent.capacity);
+            extent.offset = new_offset;
+        }
+        ledger->Allocate(layer,new_capacity - extent.capacity);
+        extent.capacity = new_capacity;
+    }
+    if(required > extent.size) extent.size = required;
+    extent.pins++;
+    extent.generation = ++*writes;
+    return std::pair<ServerStatus,long>(SERVER_SUCCESS,extent.offset);
+}
+
+ServerStatus ContainerStore::DeleteInServer(FileId file_id, Segment range) {
+    AUTO_TRACE("ContainerStore::Delete",file_id,range);
+    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    auto iter = handles->find(file_id);
+    if(iter == handles->end() || iter->second.deleted) return SERVER_SUCCESS;
+    ContainerExtent &extent = iter->second;
+    size_t start = range.start > 0 ? range.start : 0;
+    size_t end = std::min(static_cast<size_t>(range.end + 1),extent.size);
+    if(start == 0 && end >= extent.size){
+        if(extent.pins > 0){
+            extent.deleted = true;
+            return SERVER_SUCCESS;
+        }
+        allocator.Free(extent.offset,extent.capacity);
+        ledger->Free(layer,extent.capacity);
+        handles->erase(iter);
+        return SERVER_SUCCESS;
+    }
+    if(start >= end) return SERVER_SUCCESS;
+    extent.generation = ++*writes;
+    if(end == extent.size){
+        extent.size = start;
+        size_t new_capacity = Align(start);
+        allocator.Free(extent.offset + new_capacity,extent.capacity - new_capacity);
+        ledger->Free(layer,extent.capacity - new_capacity);
+        extent.capacity = new_capacity;
+        return SERVER_SUCCESS;
+    }
+    /* offsets of the remaining data stay valid, the range only gives its blocks back to the disk */
+    return PunchHole(extent.offset + start,end - start) ? SERVER_SUCCESS : SERVER_FAILED;
+}
+
+bool ContainerStore::CompactOne() {
+    FileId file_id;
+    size_t from, to, length;
+    uint64_t generation;
+    {
+        bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+        /* the last extent no transfer holds, and the end of the used space */
+        auto candidate = handles->end();
+        size_t used_end = 0;
+        for(auto iter = handles->begin(); iter != handles->end(); ++iter){
+            used_end = std::max(used_end,iter->second.offset + iter->second.capacity);
+            if(iter->second.pins > 0 || iter->second.deleted) continue;
+            if(candidate == handles->end() || iter->second.offset > candidate->second.offset) candidate = iter;
+        }
+        if(candidate == handles->end()) return false;
+        if(allocator.FreeBytesBelow(used_end) < used_end * COMPACTION_FREE_RATIO) return false;
+        length = candidate->second.capacity;
+        from = candidate->second.offset;
+        if(!allocator.Allocate(length,to,from)) return false;
+        file_id = candidate->first;
+        generation = candidate->second.generation;
+    }
+    bool copied = CopyExtent(from,to,length);
+    bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+    auto iter = handles->find(file_id);
+    if(!copied || iter == handles->end() || iter->second.deleted || iter->second.pins > 0 ||
+       iter->second.generation != generation){
+        allocator.Free(to,length);
+        return copied;
+    }
+    PunchHole(from,length);
+    allocator.Free(from,length);
+    iter->second.offset = to;
+    return true;
+}
+
+void ContainerStore::RunCompaction() {
+    std::unique_lock<std::mutex> lock(compactor_mutex);
+    while(!stop){
+        compactor_signal.wait_for(lock,std::chrono::milliseconds(COMPACTION_INTERVAL_MS));
+        if(stop) break;
+        lock.unlock();
+        for(size_t moves = 0; moves < MAX_COMPACTION_MOVES && CompactOne(); ++moves);
+        lock.lock();
+    }
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_CONTAINER_STORE_H
+#define HFETCH_CONTAINER_STORE_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <mpi.h>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/interprocess/containers/map.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <src/common/constants.h>
+#include <src/common/data_structure.h>
+#include <src/common/debug.h>
+#include <src/common/distributed_ds/communication/rpc_lib.h>
+#include <src/common/singleton.h>
+#include <src/common/macros.h>
+#include <src/common/configuration_manager.h>
+#include "extent_allocator.h"
+#include "descriptor_cache.h"
+#include "tier_ledger.h"
+
+namespace bip=boost::interprocess;
+
+/* placement of one buffer file inside the containers of a tier. */
+typedef struct ContainerExtent{
+    size_t offset; /* container index times the container size plus the offset within it. */
+    size_t size; /* bytes of the buffer file. */
+    size_t capacity; /* bytes reserved for it, a multiple of DIRECT_IO_ALIGNMENT. */
+    uint32_t pins; /* transfers in progress on the extent. */
+    uint64_t generation; /* changes on every write, so compaction drops a copy that went stale. */
+    bool deleted; /* removed while pinned, released by the last Unpin. */
+    ContainerExtent():offset(0),size(0),capacity(0),pins(0),generation(0),deleted(false){}
+} ContainerExtent;
+
+/**
+ * Holds the buffer files of one file tier inside a few large container files per server, which
+ * are preallocated with fallocate as the tier fills. Each buffer file is an extent of a container,
+ * so creating, growing and deleting one is a free list update instead of a file system metadata
+ * operation. The extent map lives in the shared memory of the server a buffer id hashes to and
+ * is reached over RPC from other nodes; the data itself is transferred by the caller on the
+ * container file. Transfers pin their extent, and a background thread on every server moves
+ * unpinned extents from the end of its containers into earlier holes.
+ */
+class ContainerStore{
+private:
+    typedef std::pair<const FileId, ContainerExtent> HandleValue;
+    typedef bip::allocator<HandleValue, bip::managed_shared_memory::segment_manager> HandleAllocator;
+    typedef bip::map<FileId, ContainerExtent, std::less<FileId>, HandleAllocator> HandleTable;
+    Layer layer;
+    bool is_server;
+    uint16_t my_server;
+    int num_servers;
+    size_t container_size, max_containers;
+    really_long memory_allocated;
+    bip::managed_shared_memory segment;
+    std::string name,func_prefix;
+    std::shared_ptr<RPC> rpc;
+    std::shared_ptr<TierLedger> ledger;
+    HandleTable* handles;
+    ExtentAllocator allocator;
+    size_t* containers; /* containers created so far on this server */
+    uint64_t* writes;
+    bip::interprocess_mutex* mutex;
+    /* container files opened by this process, keyed by server and index */
+    std::map<std::pair<uint16_t,size_t>,std::shared_ptr<Descriptor>> descriptors;
+    std::mutex descriptor_mutex;
+    std::thread compactor;
+    std::mutex compactor_mutex;
+    std::condition_variable compactor_signal;
+    bool stop;
+
+    uint16_t GetServer(FileId file_id){
+        return static_cast<uint16_t>(std::hash<FileId>()(file_id) % num_servers);
+    }
+    static size_t Align(size_t size){
+        return (size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    }
+    std::string GetContainerPath(uint16_t server, size_t index){
+        return std::string(layer.layer_loc.c_str())+FILE_SEPARATOR+"container_"+std::to_string(server)+"_"+std::to_string(index)+".hfetch";
+    }
+    std::shared_ptr<Descriptor> GetContainer(uint16_t server, size_t index);
+    /* the following run on this server with the store lock held */
+    bool AddContainer();
+    bool AllocateExtent(size_t length, size_t &offset);
+    bool CopyExtent(size_t from, size_t to, size_t length);
+    bool PunchHole(size_t offset, size_t length);
+    bool CompactOne();
+    void RunCompaction();
+public:
+    ~ContainerStore();
+    ContainerStore(Layer layer_, bool is_server_, uint16_t my_server_, int num_servers_);
+
+    std::pair<bool,Segment> PinInServer(FileId file_id);
+    bool UnpinInServer(FileId file_id);
+    std::pair<ServerStatus,long> ReserveInServer(FileId file_id, long end);
+    ServerStatus DeleteInServer(FileId file_id, Segment range);
+
+    /**
+     * Pin the extent of a buffer file for a read.
+     * @return the extent as a range of store offsets, false if the buffer does not exist
+     */
+    std::pair<bool,Segment> Pin(FileId file_id){
+        uint16_t server = GetServer(file_id);
+        if(server == my_server) return PinInServer(file_id);
+        return rpc->call(server,func_prefix+"_Pin",file_id).template as<std::pair<bool,Segment>>();
+    }
+
+    /* end a transfer started by Pin or Reserve. */
+    bool Unpin(FileId file_id){
+        uint16_t server = GetServer(file_id);
+        if(server == my_server) return UnpinInServer(file_id);
+        return rpc->call(server,func_prefix+"_Unpin",file_id).template as<bool>();
+    }
+
+    /**
+     * Create or grow a buffer file to end bytes and pin its extent for a write.
+     * @return store offset of the extent, SERVER_FAILED if the tier is full
+     */
+    std::pair<ServerStatus,long> Reserve(FileId file_id, long end){
+        uint16_t server = GetServer(file_id);
+        if(server == my_server) return ReserveInServer(file_id, end);
+        return rpc->call(server,func_prefix+"_Reserve",file_id,end).template as<std::pair<ServerStatus,long>>();
+    }
+
+    /* remove range of a buffer file, releasing its extent once the whole file is gone. */
+    ServerStatus Delete(FileId file_id, Segment range){
+        uint16_t server = GetServer(file_id);
+        if(server == my_server) return DeleteInServer(file_id, range);
+        return rpc->call(server,func_prefix+"_Delete",file_id,range).template as<ServerStatus>();
+    }
+
+    /**
+     * Find the container holding a store offset of a pinned buffer file.
+     * @return descriptor of the container and the offset within it, nullptr if it cannot be opened
+     */
+    std::pair<std::shared_ptr<Descriptor>,off_t> Locate(FileId file_id, long position){
+        return std::pair<std::shared_ptr<Descriptor>,off_t>(GetContainer(GetServer(file_id),position / container_size),
+                                                            position % container_size);
+    }
+};
+
+/* the container stores of every file tier that holds buffer files. */
+class ContainerManager{
+private:
+    std::unordered_map<uint8_t,std::shared_ptr<ContainerStore>> stores;
+public:
+    ContainerManager():stores(){
+        AUTO_TRACE("ContainerManager");
+        Layer* current=Layer::FIRST;
+        while(current != nullptr){
+            if(*current != *Layer::LAST && current->io_client_type != IOClientType::SIMPLE_MEMORY){
+                stores.emplace(current->id_,std::make_shared<ContainerStore>(*current,CONF->is_server,CONF->my_server,CONF->num_servers));
+            }
+            current = current->next;
+        }
+    }
+    /* store holding the file, nullptr for files kept as plain files of their layer */
+    std::shared_ptr<ContainerStore> Get(const PosixFile &file){
+        if(!(file.file_id & BUFFER_FILE_TAG)) return nullptr;
+        auto iter = stores.find(file.layer.id_);
+        if(iter == stores.end()) return nullptr;
+        return iter->second;
+    }
+};
+#endif //HFETCH_CONTAINER_STORE_H
@@ -25,6 +25,10 @@
 #ifndef HFETCH_DATA_MANAGER_H
 #define HFETCH_DATA_MANAGER_H
 
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
 #include <src/common/enumerations.h>
 #include <src/common/data_structure.h>
 
@@ -32,101 +36,192 @@ class DataManager{
 private:
     std::shared_ptr<IOClientFactory> ioFactory;
     std::shared_ptr<FileSegmentAuditor> fileSegmentAuditor;
+    std::shared_ptr<TierLedger> ledger;
     GlobalSequence file_id_seq;
+    /* original file to the moves of its data in flight, as source file and source range */
+    std::unordered_map<FileId,std::vector<std::pair<FileId,Segment>>> in_flight;
+    /* work waiting for the moves of an original file to finish */
+    std::unordered_map<FileId,std::vector<std::function<void()>>> on_moves_completed;
+    std::mutex in_flight_mutex;
 public:
     DataManager():file_id_seq("FILE_NUM_SEQ",CONF->is_server,CONF->my_server,CONF->num_servers){
-        AutoTrace trace = AutoTrace("DataManager");
+        AUTO_TRACE("DataManager");
         ioFactory = Singleton<IOClientFactory>::GetInstance();
         fileSegmentAuditor = Singleton<FileSegmentAuditor>::GetInstance();
+        ledger = Singleton<TierLedger>::GetInstance("TIER_LEDGER",CONF->is_server,CONF->my_server,CONF->num_servers);
     }
-    ServerStatus Move(PosixFile source, PosixFile destination, bool deleteSource = true) {
-        AutoTrace trace = AutoTrace("DataManager::Move",source,destination,deleteSource);
-        ServerStatus status;
+    /**
+     * Copy source into destination in MOVE_CHUNK_SIZE pieces through two buffers, so that the read
+     * of a piece overlaps the write of the previous one and a move never holds more than two pieces.
+     */
+    ServerStatus Stream(PosixFile &source, PosixFile &destination) {
+        AUTO_TRACE("DataManager::Stream",source,destination);
+        auto reader = ioFactory->GetClient(source.layer.io_client_type);
+        auto writer = ioFactory->GetClient(destination.layer.io_client_type);
+        long size = std::min(source.GetSize(),destination.GetSize());
+        /* reserve the whole destination up front so that its pieces do not grow it one by one */
+        PosixFile whole_destination = destination;
+        whole_destination.segment.end = destination.segment.start + size - 1;
+        if(writer->Preallocate(whole_destination) != SERVER_SUCCESS) return SERVER_FAILED;
+        PosixFile pieces[2];
+        std::future<ServerStatus> pending_write;
+        ServerStatus status = SERVER_SUCCESS;
+        int current = 0;
+        for(long offset = 0; offset < size; offset += MOVE_CHUNK_SIZE, current ^= 1){
+            long length = std::min(static_cast<long>(MOVE_CHUNK_SIZE),size - offset);
+            PosixFile chunk_source = source;
+            chunk_source.segment = Segment(source.segment.start + offset, source.segment.start + offset + length - 1);
+            PosixFile &piece = pieces[current];
+            piece.data.resize(length);
+            piece.segment = Segment(0, length - 1);
+            struct iovec buffer = {piece.data.mutable_data(), static_cast<size_t>(length)};
+            status = reader->Read(chunk_source,buffer);
+            /* the other buffer is free again once its write finished */
+            if(pending_write.valid() && pending_write.get() != SERVER_SUCCESS) status = SERVER_FAILED;
+            if(status != SERVER_SUCCESS) break;
+            PosixFile chunk_destination = destination;
+            chunk_destination.segment = Segment(destination.segment.start + offset, destination.segment.start + offset + length - 1);
+            pending_write = std::async(std::launch::async,[writer,&piece,chunk_destination]() mutable {
+                return writer->Write(piece,chunk_destination);
+            });
+        }
+        if(pending_write.valid() && pending_write.get() != SERVER_SUCCESS) status = SERVER_FAILED;
+        return status;
+    }
+
+    ServerStatus Move(PosixFile &source, PosixFile &destination, bool deleteSource = true) {
+        AUTO_TRACE("DataManager::Move",source,destination,deleteSource);
+        ServerStatus status = SERVER_SUCCESS;
         if(source.GetSize()>0){
-            destination.data.reserve(source.GetSize());
-            status = ioFactory->GetClient(source.layer.io_client_type)->Read(source,destination);
+            /* file to file moves reachable from this host are copied by the kernel */
+            auto source_file = std::dynamic_pointer_cast<SharedFileClient>(ioFactory->GetClient(source.layer.io_client_type));
+            auto destination_file = std::dynamic_pointer_cast<SharedFileClient>(ioFactory->GetClient(destination.layer.io_client_type));
+            status = SERVER_FAILED;
+            if(source_file != nullptr && destination_file != nullptr)
+                status = destination_file->CopyFrom(*source_file,source,destination);
+            if(status != SERVER_SUCCESS) status = Stream(source,destination);
             if(status != SERVER_SUCCESS) return status;
-            status = ioFactory->GetClient(destination.layer.io_client_type)->Write(destination,destination);
-            if(status != SERVER_SUCCESS) return status;
-            destination.data.erase();
             if(deleteSource) status = ioFactory->GetClient(source.layer.io_client_type)->Delete(source);
         }
         return status;
     }
 
-    ServerStatus Prefetch(PosixFile source, PosixFile destination) {
-        AutoTrace trace = AutoTrace("DataManager::Prefetch",source,destination);
-        return Move(source,destination,source.layer!=*Layer::LAST);
+    /**
+     * Record a move of data of the original file out of source, whichever tier source is in.
+     * @return false if a move of source covering its range is already in flight
+     */
+    bool BeginMove(FileId original, const PosixFile &source) {
+        AUTO_TRACE("DataManager::BeginMove",original,source);
+        std::lock_guard<std::mutex> lock(in_flight_mutex);
+        auto &moves = in_flight[original];
+        for(auto &move:moves){
+            if(move.first == source.file_id && move.second.start <= source.segment.start && source.segment.end <= move.second.end) return false;
+        }
+        moves.emplace_back(source.file_id,source.segment);
+        return true;
+    }
+
+    /* end a move started by BeginMove, running what waited for the last move of the original file. */
+    void EndMove(FileId original, const PosixFile &source) {
+        AUTO_TRACE("DataManager::EndMove",original,source);
+        std::vector<std::function<void()>> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(in_flight_mutex);
+            auto iter = in_flight.find(original);
+            if(iter == in_flight.end()) return;
+            auto &moves = iter->second;
+            for(auto move = moves.begin(); move != moves.end(); ++move){
+                if(move->first == source.file_id && move->second == source.segment){
+                    moves.erase(move);
+                    break;
+                }
+            }
+            if(!moves.empty()) return;
+            in_flight.erase(iter);
+            auto waiting = on_moves_completed.find(original);
+            if(waiting != on_moves_completed.end()){
+                callbacks = std::move(waiting->second);
+                on_moves_completed.erase(waiting);
+            }
+        }
+        for(auto &callback:callbacks) callback();
+    }
+
+    /* run callback once no move of the original file is in flight, right away if none is. */
+    void OnMovesCompleted(FileId original, std::function<void()> callback) {
+        AUTO_TRACE("DataManager::OnMovesCompleted",original);
+        {
+            std::lock_guard<std::mutex> lock(in_flight_mutex);
+            if(in_flight.find(original) != in_flight.end()){
+                on_moves_completed[original].push_back(std::move(callback));
+                return;
+            }
+        }
+        callback();
+    }
+
+    ServerStatus Prefetch(PosixFile &source, PosixFile &destination) {
+        AUTO_TRACE("DataManager::Prefetch",source,destination);
+        /* hold the space until the write has been accounted by the destination client */
+        ledger->Reserve(destination.layer,destination.GetSize());
+        ServerStatus status = Move(source,destination,source.layer!=*Layer::LAST);
+        ledger->Release(destination.layer,destination.GetSize());
+        return status;
     }
 
     bool HasCapacity(long amount, Layer layer){
-        AutoTrace trace = AutoTrace("DataManager::HasCapacity",amount,layer);
-        double remaining_capacity = layer.capacity_mb_*MB-ioFactory->GetClient(layer.io_client_type)->GetCurrentUsage(layer);
+        AUTO_TRACE("DataManager::HasCapacity",amount,layer);
+        double remaining_capacity = layer.capacity_mb_*MB-ledger->GetCurrentUsage(layer);
         remaining_capacity = remaining_capacity<0?0:remaining_capacity;
         return remaining_capacity >= amount;
     }
 
-    ServerStatus MakeCapacity(long amount, double score, Layer layer){
-        AutoTrace trace = AutoTrace("DataManager::MakeCapacity",amount,score,layer);
-        /* if layer can fit it not return error */
-        if(!CanFit(amount,layer)) return ServerStatus::SERVER_FAILED;
-        /* Last layer always has space */
+    /**
+     * Free at least amount bytes of layer held by this server by evicting its lowest scored data below
+     * score. The entries are claimed on the score index first, so concurrent evictions never pick the
+     * same data. Each segment is demoted to the next layer when that layer has room and dropped
+     * otherwise, as the original file still holds it, so an eviction never cascades into the layers
+     * below. Entries that could not be evicted are put back.
+     * @return SERVER_FAILED if the data below score does not cover amount
+     */
+    ServerStatus Evict(long amount, double score, Layer layer){
+        AUTO_TRACE("DataManager::Evict",amount,score,layer);
         if(layer == *Layer::LAST) return ServerStatus::SERVER_SUCCESS;
-        /* fetch layer scores */
-        auto layerScore = fileSegmentAuditor->FetchLayerScores();
-        auto layerScoreMap = layerScore.find(layer.id_)->second;
-        /* Check what data to be moved so that space can be made */
-        double remaining_capacity = layer.capacity_mb_*MB-ioFactory->GetClient(layer.io_client_type)->GetCurrentUsage(layer);
-        remaining_capacity = remaining_capacity<0?0:remaining_capacity;
-        long required_space = remaining_capacity;
-        double this_layer_score=0;
-        auto iter = layerScoreMap.end();
-        while(iter!=layerScoreMap.begin() && iter->first < score && required_space <amount){
-            required_space += iter->second.second.GetSize();
-            this_layer_score = iter->first;
-            iter--;
-        }
-        iter++;
-
-        /* if layer doesnt have capacity move data to next layer to make capacity*/
-        if(!HasCapacity(amount,*layer.next)){
-            MakeCapacity(amount, this_layer_score, *layer.next);
-        }
-        /* At this point we have ensured we have space in next layer
-         * Move this layer data to next layer and update MDM */
-        while(iter!=layerScoreMap.end()){
-            if(iter->second.second.GetSize() > required_space){
-                auto orig_pieces = Split(iter->second.first,required_space);
-                auto buf_pieces = Split(iter->second.second,required_space);
-                PosixFile source = buf_pieces[1];
-                PosixFile destination = source;
-                destination.layer = *layer.next;
-                destination.segment.start = 0;
-                destination.segment.end = source.GetSize() - 1;
-                if(source.layer != *Layer::LAST) destination.filename = GenerateBufferFilename();
-                if(destination.layer == *Layer::LAST){
-                    destination = iter->second.first;
-                }
-                Move(source,destination,source.layer != *Layer::LAST);
-                fileSegmentAuditor->UpdateOnMove(orig_pieces[1],destination);
-                required_space-=buf_pieces[1].GetSize();
-            }else{
-                PosixFile source = iter->second.second;
-                PosixFile destination = iter->second.second;
-                destination.layer = *layer.next;
-                if(destination.layer == *Layer::LAST){
-                    destination = iter->second.first;
-                }
-                Move(source,destination,source.layer != *Layer::LAST);
-                fileSegmentAuditor->UpdateOnMove(iter->second.first,destination);
-                required_space-=source.GetSize();
+        auto scores = fileSegmentAuditor->GetLayerScores(layer);
+        long evicted = 0;
+        auto claimed = scores->Claim(score,amount,CONF->my_server);
+        for(auto entry:claimed){
+            BufferedSegment &buffered = entry.second.second;
+            PosixFile original;
+            original.file_id = buffered.file_id;
+            original.segment = buffered.segment;
+            original.layer = *Layer::LAST;
+            PosixFile buffer;
+            buffer.file_id = buffered.buffer_id;
+            buffer.segment = buffered.buffer_segment;
+            buffer.layer = Layer(buffered.layer_id);
+            PosixFile destination = original;
+            /* a buffer already being moved by a placement is left to it */
+            if(!BeginMove(original.file_id,buffer)){
+                scores->Restore(entry.second.first,entry.first,buffered);
+                continue;
             }
-            iter++;
+            ServerStatus status;
+            if(*layer.next != *Layer::LAST && HasCapacity(buffer.GetSize(),*layer.next)){
+                destination.file_id = GenerateBufferFileId();
+                destination.layer = *layer.next;
+                destination.segment = Segment(0,buffer.GetSize() - 1);
+                status = Move(buffer,destination);
+            }else status = ioFactory->GetClient(buffer.layer.io_client_type)->Delete(buffer);
+            if(status == SERVER_SUCCESS) fileSegmentAuditor->UpdateOnMove(original,destination);
+            else scores->Restore(entry.second.first,entry.first,buffered);
+            EndMove(original.file_id,buffer);
+            if(status == SERVER_SUCCESS) evicted += buffer.GetSize();
         }
-        return ServerStatus::SERVER_SUCCESS;
+        return evicted >= amount ? ServerStatus::SERVER_SUCCESS : ServerStatus::SERVER_FAILED;
     }
-    std::vector<PosixFile> Split(PosixFile file, long remaining_capacity) {
-        AutoTrace trace = AutoTrace("DataManager::Split",file,remaining_capacity);
+    std::vector<PosixFile> Split(const PosixFile &file, long remaining_capacity) {
+        AUTO_TRACE("DataManager::Split",file,remaining_capacity);
         std::vector<PosixFile> pieces=std::vector<PosixFile>();
         PosixFile p1=file;
         p1.segment.end = p1.segment.start + remaining_capacity - 1;
@@ -137,13 +232,14 @@ public:
         return pieces;
     }
     ServerStatus CanFit(long amount, Layer layer){
-        AutoTrace trace = AutoTrace("DataManager::CanFit",amount,layer);
+        AUTO_TRACE("DataManager::CanFit",amount,layer);
         /* Last layer can always fit and for others check capacity*/
         return layer == *Layer::LAST || layer.capacity_mb_*MB >= amount?ServerStatus::SERVER_SUCCESS:ServerStatus::SERVER_FAILED;
     }
-    CharStruct GenerateBufferFilename() {
-        AutoTrace trace = AutoTrace("DataManager::GenerateBufferFilename");
-        return CharStruct(std::to_string(file_id_seq.GetNextSequenceServer(0)) + ".hfetch");
+    /* buffer ids are tagged so that they resolve to "<sequence>.hfetch" without a dictionary entry */
+    FileId GenerateBufferFileId() {
+        AUTO_TRACE("DataManager::GenerateBufferFileId");
+        return BUFFER_FILE_TAG | file_id_seq.GetNextSequenceLeased(0);
     }
 };
 #endif //HFETCH_DATA_MANAGER_H
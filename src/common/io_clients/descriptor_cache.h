@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_DESCRIPTOR_CACHE_H
+#define HFETCH_DESCRIPTOR_CACHE_H
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <src/common/constants.h>
+#include <src/common/data_structure.h>
+
+/* an open file descriptor, closed once the cache and every user dropped it. */
+typedef struct Descriptor{
+    int fd;
+    bool writable;
+    bool direct; /* opened with O_DIRECT, transfers must be aligned to DIRECT_IO_ALIGNMENT */
+    Descriptor(int fd_, bool writable_, bool direct_):fd(fd_),writable(writable_),direct(direct_){}
+    ~Descriptor(){
+        if(fd >= 0) close(fd);
+    }
+} Descriptor;
+
+/**
+ * Keeps the most recently used files of the layers open. Entries are keyed by layer and file id
+ * and evicted least recently used first. Users hold a shared_ptr to the descriptor, so an entry
+ * evicted or invalidated while an I/O is in progress is closed only when that I/O finished.
+ */
+class DescriptorCache{
+private:
+    typedef std::pair<uint8_t,FileId> Key;
+    struct KeyHash{
+        size_t operator()(const Key &key) const {
+            return std::hash<FileId>()(key.second) ^ (static_cast<size_t>(key.first) << 56);
+        }
+    };
+    typedef std::pair<std::shared_ptr<Descriptor>,std::list<Key>::iterator> Entry;
+    size_t max_descriptors;
+    std::list<Key> lru; /* most recently used first */
+    std::unordered_map<Key,Entry,KeyHash> descriptors;
+    std::mutex mutex;
+public:
+    explicit DescriptorCache(size_t max_descriptors_=MAX_CACHED_DESCRIPTORS):max_descriptors(max_descriptors_),lru(),descriptors(){}
+
+    /**
+     * Get an open descriptor of the file, opening it on a miss. Files of direct_io layers are
+     * opened with O_DIRECT unless their file system refuses it.
+     * @param writable, open the file for writing
+     * @param create, create a missing file, by default when opened for writing
+     * @return nullptr if the file cannot be opened, with errno set by open
+     */
+    std::shared_ptr<Descriptor> Acquire(const Layer &layer, FileId file_id, const std::string &file_path, bool writable){
+        return Acquire(layer,file_id,file_path,writable,writable);
+    }
+    std::shared_ptr<Descriptor> Acquire(const Layer &layer, FileId file_id, const std::string &file_path, bool writable, bool create){
+        Key key(layer.id_,file_id);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = descriptors.find(key);
+        if(iter != descriptors.end()){
+            if(!writable || iter->second.first->writable){
+                lru.splice(lru.begin(),lru,iter->second.second);
+                return iter->second.first;
+            }
+            /* reopen a read only descriptor for writing */
+            lru.erase(iter->second.second);
+            descriptors.erase(iter);
+        }
+        int flags = (writable ? O_RDWR : O_RDONLY) | (create ? O_CREAT : 0);
+        bool direct = layer.direct_io;
+        int fd = direct ? open(file_path.c_str(),flags | O_DIRECT,0664) : -1;
+        if(fd < 0){
+            direct = false;
+            fd = open(file_path.c_str(),flags,0664);
+        }
+        if(fd < 0) return nullptr;
+        auto descriptor = std::make_shared<Descriptor>(fd,writable,direct);
+        while(descriptors.size() >= max_descriptors && !lru.empty()){
+            descriptors.erase(lru.back());
+            lru.pop_back();
+        }
+        lru.push_front(key);
+        descriptors.emplace(key,Entry(descriptor,lru.begin()));
+        return descriptor;
+    }
+
+    /* drop the descriptor of a file that is removed or rewritten. */
+    void Invalidate(const Layer &layer, FileId file_id){
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = descriptors.find(Key(layer.id_,file_id));
+        if(iter == descriptors.end()) return;
+        lru.erase(iter->second.second);
+        descriptors.erase(iter);
+    }
+};
+#endif //HFETCH_DESCRIPTOR_CACHE_H
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_EXTENT_ALLOCATOR_H
+#define HFETCH_EXTENT_ALLOCATOR_H
+
+#include <iterator>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/interprocess/containers/map.hpp>
+
+namespace bip=boost::interprocess;
+
+/* offset to length of every unused extent, kept in shared memory. */
+typedef std::pair<const size_t, size_t> FreeExtentValue;
+typedef bip::allocator<FreeExtentValue, bip::managed_shared_memory::segment_manager> FreeExtentAllocator;
+typedef bip::map<size_t, size_t, std::less<size_t>, FreeExtentAllocator> FreeExtentList;
+
+/**
+ * First fit allocator over a free list ordered by offset. The offset space is made of regions of
+ * region_size bytes; free extents are merged with their neighbours but never across regions, so
+ * an allocation always lies within one region. Callers hold the lock protecting the list.
+ */
+class ExtentAllocator{
+private:
+    FreeExtentList* free_extents;
+    size_t region_size;
+public:
+    ExtentAllocator():free_extents(nullptr),region_size(0){}
+    ExtentAllocator(FreeExtentList* free_extents_, size_t region_size_):free_extents(free_extents_),region_size(region_size_){}
+
+    /* lowest free extent of length bytes whose end does not pass limit. */
+    bool Allocate(size_t length, size_t &offset, size_t limit=SIZE_MAX){
+        for(auto iter = free_extents->begin(); iter != free_extents->end() && iter->first + length <= limit; ++iter){
+            if(iter->second < length) continue;
+            offset = iter->first;
+            size_t remaining = iter->second - length;
+            free_extents->erase(iter);
+            if(remaining > 0) free_extents->insert(FreeExtentValue(offset + length, remaining));
+            return true;
+        }
+        return false;
+    }
+
+    /* return an extent to the free list, merging it with its neighbours in the same region. */
+    void Free(size_t offset, size_t length){
+        if(length == 0) return;
+        auto next = free_extents->lower_bound(offset);
+        if(next != free_extents->begin() && offset % region_size != 0){
+            auto previous = std::prev(next);
+            if(previous->first + previous->second == offset){
+                offset = previous->first;
+                length += previous->second;
+                free_extents->erase(previous);
+            }
+        }
+        if(next != free_extents->end() && offset + length == next->first && next->first % region_size != 0){
+            length += next->second;
+            free_extents->erase(next);
+        }
+        free_extents->insert(FreeExtentValue(offset, length));
+    }
+
+    /* extend the extent at offset from capacity to new_capacity when the following bytes are free
+     * and the grown extent stays within the region it starts in. */
+    bool Grow(size_t offset, size_t capacity, size_t new_capacity){
+        if(new_capacity <= capacity) return true;
+        if(offset / region_size != (offset + new_capacity - 1) / region_size) return false;
+        auto next = free_extents->find(offset + capacity);
+        size_t needed = new_capacity - capacity;
+        if(next == free_extents->end() || next->second < needed) return false;
+        size_t remaining = next->second - needed;
+        size_t next_offset = next->first + needed;
+        free_extents->erase(next);
+        if(remaining > 0) free_extents->insert(FreeExtentValue(next_offset, remaining));
+        return true;
+    }
+
+    /* free bytes of the extents starting below limit. */
+    size_t FreeBytesBelow(size_t limit){
+        size_t bytes = 0;
+        for(auto iter = free_extents->begin(); iter != free_extents->end() && iter->first < limit; ++iter){
+            bytes += std::min(iter->second, limit - iter->first);
+        }
+        return bytes;
+    }
+};
+#endif //HFETCH_EXTENT_ALLOCATOR_H
@@ -25,6 +25,7 @@
 #ifndef HFETCH_IO_CLIENT_H
 #define HFETCH_IO_CLIENT_H
 
+#include <sys/uio.h>
 #include <src/common/enumerations.h>
 #include <src/common/data_structure.h>
 
@@ -32,8 +33,12 @@ class IOClient{
 public:
     IOClient(){}
     virtual ServerStatus Read(PosixFile &source, PosixFile &destination) = 0;
+    /* reads the source segment straight into the caller's buffer without staging it in PosixFile::data. */
+    virtual ServerStatus Read(PosixFile &source, const struct iovec &destination) = 0;
     virtual ServerStatus Write(PosixFile &source, PosixFile &destination) = 0;
-    virtual ServerStatus Delete(PosixFile file) = 0;
+    virtual ServerStatus Delete(PosixFile &file) = 0;
+    /* reserves the space of the whole file segment ahead of a write in pieces. */
+    virtual ServerStatus Preallocate(PosixFile &file){ return SERVER_SUCCESS; }
     virtual double GetCurrentUsage(Layer l) = 0;
 
 };
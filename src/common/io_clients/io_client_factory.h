@@ -30,17 +30,23 @@
 #include "shared_file_client.h"
 #include "local_file_client.h"
 #include "memory_client.h"
+#include "uring_file_client.h"
+#include "tier_ledger.h"
 
 class IOClientFactory{
 public:
     IOClientFactory(){
-        AutoTrace trace = AutoTrace("IOClientFactory");
+        AUTO_TRACE("IOClientFactory");
+        Singleton<TierLedger>::GetInstance("TIER_LEDGER",CONF->is_server,CONF->my_server,CONF->num_servers);
+        Singleton<FileDictionary>::GetInstance("FILE_DICTIONARY",CONF->is_server,CONF->my_server,CONF->num_servers);
+        Singleton<ContainerManager>::GetInstance();
         Singleton<SharedFileClient>::GetInstance();
         Singleton<LocalFileClient>::GetInstance();
         Singleton<MemoryClient>::GetInstance();
+        Singleton<UringFileClient>::GetInstance();
     }
     std::shared_ptr<IOClient> GetClient(IOClientType type){
-        AutoTrace trace = AutoTrace("GetClient",type);
+        AUTO_TRACE("GetClient",type);
         switch(type){
             case IOClientType::SHARED_POSIX_FILE:{
                 return Singleton<SharedFileClient>::GetInstance();
@@ -51,6 +57,9 @@ public:
             case IOClientType::SIMPLE_MEMORY:{
                 return Singleton<MemoryClient>::GetInstance();
             }
+            case IOClientType::URING_LOCAL_FILE:{
+                return Singleton<UringFileClient>::GetInstance();
+            }
         }
     }
 };
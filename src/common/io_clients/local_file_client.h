@@ -30,55 +30,98 @@
 
 class LocalFileClient : public SharedFileClient{
     std::shared_ptr<RPC> rpc;
-    const std::string LOCAL_FILE_CLIENT="LOCAL_FILE_CLIENT";
+    /* prefix of the RPCs, distinct for every client type built on this one */
+    const std::string LOCAL_FILE_CLIENT;
 public:
-    LocalFileClient(): SharedFileClient("L") {
-        AutoTrace trace = AutoTrace("LocalFileClient");
+    explicit LocalFileClient(std::string name="LOCAL_FILE_CLIENT"): SharedFileClient(),LOCAL_FILE_CLIENT(name) {
+        AUTO_TRACE("LocalFileClient");
         rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",CONF->is_server,CONF->my_server,CONF->num_servers);
         if(CONF->is_server){
-            std::function<ServerStatus(PosixFile&,PosixFile&)> readFunc(std::bind(&LocalFileClient::Read, this, std::placeholders::_1, std::placeholders::_2));
+            std::function<ServerStatus(PosixFile&,PosixFile&)> readFunc(std::bind(static_cast<ServerStatus(LocalFileClient::*)(PosixFile&,PosixFile&)>(&LocalFileClient::Read), this, std::placeholders::_1, std::placeholders::_2));
             std::function<ServerStatus(PosixFile&,PosixFile&)> writeFunc(std::bind(&LocalFileClient::Write, this, std::placeholders::_1, std::placeholders::_2));
-            std::function<ServerStatus(PosixFile)> deleteFunc(std::bind(&LocalFileClient::Delete, this, std::placeholders::_1));
+            std::function<ServerStatus(PosixFile&)> deleteFunc(std::bind(&LocalFileClient::Delete, this, std::placeholders::_1));
+            std::function<ServerStatus(PosixFile&)> preallocateFunc(std::bind(&LocalFileClient::Preallocate, this, std::placeholders::_1));
+            std::function<std::pair<ServerStatus,std::string>(PosixFile&)> readDataFunc(std::bind(&LocalFileClient::ReadData, this, std::placeholders::_1));
             rpc->bind(LOCAL_FILE_CLIENT+"_Read", readFunc);
+            rpc->bind(LOCAL_FILE_CLIENT+"_ReadData", readDataFunc);
             rpc->bind(LOCAL_FILE_CLIENT+"_Write", writeFunc);
             rpc->bind(LOCAL_FILE_CLIENT+"_Delete", deleteFunc);
+            rpc->bind(LOCAL_FILE_CLIENT+"_Preallocate", preallocateFunc);
         }
     }
 
     ServerStatus Read(PosixFile &source, PosixFile &destination) override {
-        std::size_t hash_val = std::hash<CharStruct>()(source.filename)%CONF->num_servers;
+        std::size_t hash_val = std::hash<FileId>()(source.file_id)%CONF->num_servers;
         if(hash_val == CONF->my_server){
-            AutoTrace trace = AutoTrace("LocalFileClient::Read(local)",source,destination);
+            AUTO_TRACE("LocalFileClient::Read(local)",source,destination);
             return SharedFileClient::Read(source, destination);
         }else{
-            AutoTrace trace = AutoTrace("LocalFileClient::Read(remote)",source,destination);
+            AUTO_TRACE("LocalFileClient::Read(remote)",source,destination);
             return rpc->call(hash_val,LOCAL_FILE_CLIENT+"_Read",source,destination).template as<ServerStatus>();
         }
 
     }
 
+    ServerStatus Read(PosixFile &source, const struct iovec &destination) override {
+        std::size_t hash_val = std::hash<FileId>()(source.file_id)%CONF->num_servers;
+        if(hash_val == CONF->my_server){
+            AUTO_TRACE("LocalFileClient::Read(iovec,local)",source,destination.iov_len);
+            return SharedFileClient::Read(source, destination);
+        }else{
+            AUTO_TRACE("LocalFileClient::Read(iovec,remote)",source,destination.iov_len);
+            auto result = rpc->call(hash_val,LOCAL_FILE_CLIENT+"_ReadData",source).template as<std::pair<ServerStatus,std::string>>();
+            if(result.first == SERVER_SUCCESS) memcpy(destination.iov_base,result.second.data(),std::min(result.second.size(),destination.iov_len));
+            return result.first;
+        }
+    }
+
+    /* serves a remote iovec read from the server owning the buffer file. */
+    std::pair<ServerStatus,std::string> ReadData(PosixFile &source){
+        AUTO_TRACE("LocalFileClient::ReadData",source);
+        std::string data(source.GetSize(),'\0');
+        struct iovec destination = {&data[0],data.size()};
+        ServerStatus status = SharedFileClient::Read(source, destination);
+        return std::pair<ServerStatus,std::string>(status,data);
+    }
+
     ServerStatus Write(PosixFile &source, PosixFile &destination) override {
-        std::size_t hash_val = std::hash<CharStruct>()(source.filename)%CONF->num_servers;
+        std::size_t hash_val = std::hash<FileId>()(destination.file_id)%CONF->num_servers;
         if(hash_val == CONF->my_server){
-            AutoTrace trace = AutoTrace("LocalFileClient::Write(local)",source,destination);
+            AUTO_TRACE("LocalFileClient::Write(local)",source,destination);
             return SharedFileClient::Write(source, destination);
         }else{
-            AutoTrace trace = AutoTrace("LocalFileClient::Write(remote)",source,destination);
+            AUTO_TRACE("LocalFileClient::Write(remote)",source,destination);
             return rpc->call(hash_val,LOCAL_FILE_CLIENT+"_Write",source,destination).template as<ServerStatus>();
         }
     }
 
-    ServerStatus Delete(PosixFile file) override {
-        std::size_t hash_val = std::hash<CharStruct>()(file.filename)%CONF->num_servers;
+    ServerStatus Delete(PosixFile &file) override {
+        std::size_t hash_val = std::hash<FileId>()(file.file_id)%CONF->num_servers;
         if(hash_val == CONF->my_server){
-            AutoTrace trace = AutoTrace("LocalFileClient::Delete(local)",file);
+            AUTO_TRACE("LocalFileClient::Delete(local)",file);
             return SharedFileClient::Delete(file);
         }else{
-            AutoTrace trace = AutoTrace("LocalFileClient::Delete(remote)",file);
+            AUTO_TRACE("LocalFileClient::Delete(remote)",file);
             return rpc->call(hash_val,LOCAL_FILE_CLIENT+"_Delete",file).template as<ServerStatus>();
         }
     }
 
+    ServerStatus Preallocate(PosixFile &file) override {
+        std::size_t hash_val = std::hash<FileId>()(file.file_id)%CONF->num_servers;
+        if(hash_val == CONF->my_server){
+            AUTO_TRACE("LocalFileClient::Preallocate(local)",file);
+            return SharedFileClient::Preallocate(file);
+        }else{
+            AUTO_TRACE("LocalFileClient::Preallocate(remote)",file);
+            return rpc->call(hash_val,LOCAL_FILE_CLIENT+"_Preallocate",file).template as<ServerStatus>();
+        }
+    }
+
+    bool IsLocal(const PosixFile &file) override {
+        std::size_t hash_val = std::hash<FileId>()(file.file_id)%CONF->num_servers;
+        return hash_val == CONF->my_server;
+    }
+
     double GetCurrentUsage(Layer layer) override {
         return SharedFileClient::GetCurrentUsage(layer);
     }
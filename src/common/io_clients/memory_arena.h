@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_MEMORY_ARENA_H
+#define HFETCH_MEMORY_ARENA_H
+
+#include <cstring>
+#include <mpi.h>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/interprocess/containers/map.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <src/common/constants.h>
+#include <src/common/data_structure.h>
+#include <src/common/debug.h>
+#include "extent_allocator.h"
+
+namespace bip=boost::interprocess;
+
+/* placement of one buffer file inside the arena. */
+typedef struct BufferExtent{
+    size_t offset; /* start of the extent from the arena base. */
+    size_t size; /* bytes of the buffer file. */
+    size_t capacity; /* bytes reserved for it, a multiple of ARENA_ALIGNMENT. */
+    uint32_t pins; /* copies in progress on the extent. */
+    bool deleted; /* removed while pinned, released by the last Unpin. */
+    BufferExtent():offset(0),size(0),capacity(0),pins(0),deleted(false){}
+} BufferExtent;
+
+/**
+ * One preallocated region of node shared memory holding every buffer file of a memory layer.
+ * Extents are handed out first fit from a free list ordered by offset, which coalesces on free,
+ * and a handle table maps buffer ids to their extent. Clients map the arena once, so reads,
+ * writes and deletes are offset arithmetic. The arena lock is only held to look up and pin an
+ * extent; the data is copied after releasing it, and an extent deleted while pinned is released
+ * by its last Unpin. The region is sized to the layer capacity, which makes that capacity a hard
+ * limit.
+ */
+class MemoryArena{
+private:
+    static const size_t ARENA_ALIGNMENT=64;
+    typedef std::pair<const FileId, BufferExtent> HandleValue;
+    typedef bip::allocator<HandleValue, bip::managed_shared_memory::segment_manager> HandleAllocator;
+    typedef bip::map<FileId, BufferExtent, std::less<FileId>, HandleAllocator> HandleTable;
+    bool is_server;
+    std::string name;
+    size_t capacity;
+    bip::managed_shared_memory segment;
+    char* base;
+    HandleTable* handles;
+    ExtentAllocator allocator;
+    bip::interprocess_mutex* mutex;
+
+    static size_t Align(size_t size){
+        return (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    }
+
+    /* end a copy on the extent of a buffer file. */
+    void Unpin(FileId file_id){
+        bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+        auto iter = handles->find(file_id);
+        if(iter == handles->end() || iter->second.pins == 0) return;
+        BufferExtent &extent = iter->second;
+        if(--extent.pins == 0 && extent.deleted){
+            allocator.Free(extent.offset, extent.capacity);
+            handles->erase(iter);
+        }
+    }
+public:
+    ~MemoryArena(){
+        if(is_server) bip::shared_memory_object::remove(name.c_str());
+    }
+    MemoryArena(std::string name_, bool is_server_, uint16_t my_server_, size_t capacity_)
+            :is_server(is_server_),name(name_),capacity(Align(capacity_)),segment(),base(),handles(),allocator(),mutex(){
+        AUTO_TRACE("MemoryArena",name_,is_server_,my_server_,capacity_);
+        name=name+"_"+std::to_string(my_server_);
+        if(is_server){
+            bip::shared_memory_object::remove(name.c_str());
+            /* room for the tables next to the data region */
+            segment=bip::managed_shared_memory(bip::create_only, name.c_str(), capacity + capacity / 16 + 4 * MB);
+            base = static_cast<char*>(segment.allocate_aligned(capacity > 0 ? capacity : ARENA_ALIGNMENT, ARENA_ALIGNMENT));
+            segment.construct<bip::managed_shared_memory::handle_t>("Base")(segment.get_handle_from_address(base));
+            handles = segment.construct<HandleTable>("Handles")(std::less<FileId>(), segment.get_segment_manager());
+            FreeExtentList* free_extents = segment.construct<FreeExtentList>("Free")(std::less<size_t>(), segment.get_segment_manager());
+            mutex = segment.construct<bip::interprocess_mutex>("mtx")();
+            if(capacity > 0) free_extents->insert(FreeExtentValue(0, capacity));
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if(!is_server){
+            segment=bip::managed_shared_memory(bip::open_only,name.c_str());
+            base = static_cast<char*>(segment.get_address_from_handle(*segment.find<bip::managed_shared_memory::handle_t>("Base").first));
+            handles = segment.find<HandleTable>("Handles").first;
+            mutex = segment.find<bip::interprocess_mutex>("mtx").first;
+        }
+        allocator = ExtentAllocator(segment.find<FreeExtentList>("Free").first, capacity > 0 ? capacity : ARENA_ALIGNMENT);
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    /**
+     * Write size bytes at offset of the buffer file, creating or growing it as needed.
+     * @param reserved, set to the change of bytes reserved by the arena
+     * @return SERVER_FAILED if the arena cannot hold the grown buffer
+     */
+    ServerStatus Write(FileId file_id, size_t offset, const char* data, size_t size, long long &reserved){
+        size_t position;
+        {
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            reserved = 0;
+            auto iter = handles->find(file_id);
+            size_t required = offset + size;
+            if(iter == handles->end()){
+                BufferExtent extent;
+                extent.capacity = Align(required);
+                if(!allocator.Allocate(extent.capacity, extent.offset)) return SERVER_FAILED;
+                iter = handles->insert(HandleValue(file_id, extent)).first;
+                reserved = extent.capacity;
+            }
+            BufferExtent &extent = iter->second;
+            if(extent.deleted) return SERVER_FAILED;
+            if(required > extent.capacity){
+                size_t new_capacity = Align(required);
+                size_t old_capacity = extent.capacity;
+                if(!allocator.Grow(extent.offset, extent.capacity, new_capacity)){
+                    /* relocating would pull the extent from under copies still using it */
+                    if(extent.pins > 0) return SERVER_FAILED;
+                    size_t new_offset;
+                    if(!allocator.Allocate(new_capacity, new_offset)) return SERVER_FAILED;
+                    memcpy(base + new_offset, base + extent.offset, extent.size);
+                    allocator.Free(extent.offset, extent.capacity);
+                    extent.offset = new_offset;
+                }
+                extent.capacity = new_capacity;
+                reserved = extent.capacity - old_capacity;
+            }
+            /* the gap is cleared before the size covers it, so it never overwrites a later write into it */
+            if(offset > extent.size) memset(base + extent.offset + extent.size, 0, offset - extent.size);
+            if(required > extent.size) extent.size = required;
+            extent.pins++;
+            position = extent.offset;
+        }
+        memcpy(base + position + offset, data, size);
+        Unpin(file_id);
+        return SERVER_SUCCESS;
+    }
+
+    /**
+     * Copy size bytes at offset of the buffer file into destination.
+     * @return SERVER_FAILED if the buffer does not hold the range
+     */
+    ServerStatus Read(FileId file_id, size_t offset, char* destination, size_t size){
+        size_t position;
+        {
+            bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+            auto iter = handles->find(file_id);
+            if(iter == handles->end() || iter->second.deleted || offset + size > iter->second.size) return SERVER_FAILED;
+            iter->second.pins++;
+            position = iter->second.offset;
+        }
+        memcpy(destination, base + position + offset, size);
+        Unpin(file_id);
+        return SERVER_SUCCESS;
+    }
+
+    /**
+     * Remove range from the buffer file. Offsets of the remaining bytes stay valid, so only a
+     * range reaching the end of the buffer releases the extent tail it no longer needs, once no copy
+     * is in progress. A whole buffer deleted while pinned counts as released at once.
+     * @return bytes released by the arena
+     */
+    long long Delete(FileId file_id, Segment range){
+        bip::scoped_lock<bip::interprocess_mutex> lock(*mutex);
+        auto iter = handles->find(file_id);
+        if(iter == handles->end() || iter->second.deleted) return 0;
+        BufferExtent &extent = iter->second;
+        size_t start = range.start > 0 ? range.start : 0;
+        size_t end = std::min(static_cast<size_t>(range.end + 1), extent.size);
+        if(start == 0 && end >= extent.size){
+            long long released = extent.capacity;
+            if(extent.pins > 0){
+                extent.deleted = true;
+                return released;
+            }
+            allocator.Free(extent.offset, extent.capacity);
+            handles->erase(iter);
+            return released;
+        }
+        if(start >= end || end < extent.size) return 0;
+        extent.size = start;
+        /* the tail may still be copied to, a later delete releases it */
+        if(extent.pins > 0) return 0;
+        size_t new_capacity = Align(extent.size);
+        long long released = extent.capacity - new_capacity;
+        allocator.Free(extent.offset + new_capacity, extent.capacity - new_capacity);
+        extent.capacity = new_capacity;
+        return released;
+    }
+};
+#endif //HFETCH_MEMORY_ARENA_H
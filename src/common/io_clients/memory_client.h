@@ -26,48 +26,53 @@
 #define HFETCH_MEMORY_CLIENT_H
 
 
-#include <src/common/distributed_ds/hashmap/DistributedHashMap.h>
-#include <boost/interprocess/containers/string.hpp>
+#include <unordered_map>
+#include <src/common/distributed_ds/communication/rpc_lib.h>
+#include <src/common/singleton.h>
+#include <src/common/macros.h>
 #include <src/common/configuration_manager.h>
 #include <src/common/data_structure.h>
 #include "io_client.h"
-
-namespace bip=boost::interprocess;
-typedef bip::allocator<char, bip::managed_shared_memory::segment_manager> CharAllocator;
-typedef boost::interprocess::basic_string<char, std::char_traits<char>, CharAllocator> MyShmString;
-typedef boost::interprocess::allocator<MyShmString, boost::interprocess::managed_shared_memory::segment_manager> StringAllocator;
+#include "tier_ledger.h"
+#include "memory_arena.h"
 
 class MemoryClient: public IOClient {
 private:
-    DistributedHashMap<CharStruct,PosixFile> data_map;
     std::shared_ptr<RPC> rpc;
+    std::shared_ptr<TierLedger> ledger;
     const std::string MEMORY_CLIENT="MEMORY_CLIENT";
+    /* one arena per memory layer, keyed by layer id */
+    std::unordered_map<uint8_t,std::shared_ptr<MemoryArena>> arenas;
+    std::shared_ptr<MemoryArena> GetArena(const Layer &layer);
 public:
-    ~MemoryClient(){
-        AutoTrace trace = AutoTrace("~MemoryClient");
-        if(CONF->is_server){
-            auto datas = data_map.GetAllDataInServer();
-            for(auto data:datas){
-                bip::shared_memory_object::remove(data.second.filename.c_str());
+    MemoryClient():arenas(){
+        AUTO_TRACE("MemoryClient");
+        rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",CONF->is_server,CONF->my_server,CONF->num_servers);
+        ledger = Singleton<TierLedger>::GetInstance("TIER_LEDGER",CONF->is_server,CONF->my_server,CONF->num_servers);
+        Layer* current=Layer::FIRST;
+        while(current != nullptr){
+            if(current->io_client_type == IOClientType::SIMPLE_MEMORY){
+                arenas.emplace(current->id_,std::make_shared<MemoryArena>("MEMORY_ARENA_"+std::to_string(current->id_),CONF->is_server,
+                               CONF->my_server,static_cast<size_t>(current->capacity_mb_*MB)));
             }
+            current = current->next;
         }
-    }
-
-    MemoryClient():data_map("DATA_MAP",CONF->is_server,CONF->my_server,CONF->num_servers){
-        AutoTrace trace = AutoTrace("MemoryClient");
-        rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",CONF->is_server,CONF->my_server,CONF->num_servers);
         if(CONF->is_server){
-            std::function<ServerStatus(PosixFile&,PosixFile&)> readFunc(std::bind(&MemoryClient::Read, this, std::placeholders::_1, std::placeholders::_2));
+            std::function<ServerStatus(PosixFile&,PosixFile&)> readFunc(std::bind(static_cast<ServerStatus(MemoryClient::*)(PosixFile&,PosixFile&)>(&MemoryClient::Read), this, std::placeholders::_1, std::placeholders::_2));
+            std::function<std::pair<ServerStatus,std::string>(PosixFile&)> readDataFunc(std::bind(&MemoryClient::ReadData, this, std::placeholders::_1));
             std::function<ServerStatus(PosixFile&,PosixFile&)> writeFunc(std::bind(&MemoryClient::Write, this, std::placeholders::_1, std::placeholders::_2));
-            std::function<ServerStatus(PosixFile)> deleteFunc(std::bind(&MemoryClient::Delete, this, std::placeholders::_1));
+            std::function<ServerStatus(PosixFile&)> deleteFunc(std::bind(&MemoryClient::Delete, this, std::placeholders::_1));
             rpc->bind(MEMORY_CLIENT+"_Read", readFunc);
+            rpc->bind(MEMORY_CLIENT+"_ReadData", readDataFunc);
             rpc->bind(MEMORY_CLIENT+"_Write", writeFunc);
             rpc->bind(MEMORY_CLIENT+"_Delete", deleteFunc);
         }
     }
     ServerStatus Read(PosixFile &source, PosixFile &destination) override;
+    ServerStatus Read(PosixFile &source, const struct iovec &destination) override;
+    std::pair<ServerStatus,std::string> ReadData(PosixFile &source);
     ServerStatus Write(PosixFile &source, PosixFile &destination) override;
-    ServerStatus Delete(PosixFile file) override;
+    ServerStatus Delete(PosixFile &file) override;
     double GetCurrentUsage(Layer layer) override;
 };
 
@@ -22,82 +22,252 @@
 // Created by hariharan on 3/19/19.
 //
 
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <unistd.h>
 #include "shared_file_client.h"
 
-ServerStatus SharedFileClient::Read(PosixFile &source, PosixFile &destination) {
-    AutoTrace trace = AutoTrace("FileClient::Read",source,destination);
-    std::string file_path=std::string(source.layer.layer_loc.c_str())+FILE_SEPARATOR+std::string(source.filename.c_str());
-    FILE* fh = fopen(file_path.c_str(),"r");
-    fseek(fh,source.segment.start,SEEK_SET);
-    size_t size=source.segment.end-source.segment.start;
-    char* data= static_cast<char *>(malloc(size));
-    fread(data,size, 1,fh);
-    destination.data.assign(data,size);
-    fclose(fh);
-    return SERVER_SUCCESS;
+/* bytes of storage held by the open file, holes excluded. */
+static long long AllocatedBytes(int fd){
+    struct stat st;
+    if(fstat(fd,&st) != 0) return 0;
+    return static_cast<long long>(st.st_blocks) * 512;
 }
 
-ServerStatus SharedFileClient::Write(PosixFile &source, PosixFile &destination) {
-    AutoTrace trace = AutoTrace("FileClient::Write",source,destination);
-    std::string file_path=std::string(destination.layer.layer_loc.c_str())+FILE_SEPARATOR+std::string(destination.filename.c_str());
-    FILE* fh = fopen(file_path.c_str(),"r+");
-    if(fh==NULL){
-        fh = fopen(file_path.c_str(),"w+");
+/* positional read of size bytes at offset, retried until complete. */
+static ServerStatus ReadFully(int fd, char* data, size_t size, off_t offset){
+    size_t done = 0;
+    while(done < size){
+        ssize_t bytes = pread(fd,data + done,size - done,offset + done);
+        if(bytes <= 0) return SERVER_FAILED;
+        done += bytes;
     }
-    fseek(fh,destination.segment.start,SEEK_SET);
-    fwrite(source.data.c_str(),destination.segment.end-destination.segment.start, 1,fh);
-    fclose(fh);
-    hasChanged.Put(destination.layer.id_,true);
     return SERVER_SUCCESS;
 }
 
-ServerStatus SharedFileClient::Delete(PosixFile file) {
-    AutoTrace trace = AutoTrace("FileClient::Delete",file);
-    hasChanged.Put(file.layer.id_,true);
-    std::string file_path=std::string(file.layer.layer_loc.c_str())+FILE_SEPARATOR+std::string(file.filename.c_str());
-    FILE* fh = fopen(file_path.c_str(),"r");
-    size_t end = fseek(fh,0,SEEK_END);
-    if(file.segment.end - file.segment.start + 1 - end == 0){
-        remove(file_path.c_str());
-        return SERVER_SUCCESS;
+/* positional write of size bytes at offset, retried until complete. */
+static ServerStatus WriteFully(int fd, const char* data, size_t size, off_t offset){
+    size_t done = 0;
+    while(done < size){
+        ssize_t bytes = pwrite(fd,data + done,size - done,offset + done);
+        if(bytes <= 0) return SERVER_FAILED;
+        done += bytes;
     }
-    fseek(fh,0,SEEK_SET);
-    void* data=malloc(end);
-    fread(data,end, 1,fh);
-    fclose(fh);
-    fh = fopen(file_path.c_str(),"w+");
-    if(file.segment.start > 0) fwrite(data, file.segment.start - 1, 1, fh);
-    if(file.segment.end < end) fwrite((char*)data + file.segment.end, end - file.segment.end + 1, 1, fh);
-    fclose(fh);
-    hasChanged.Put(file.layer.id_,true);
     return SERVER_SUCCESS;
 }
 
-double SharedFileClient::GetCurrentUsage(Layer layer) {
-    AutoTrace trace = AutoTrace("FileClient::GetCurrentUsage",layer);
-    auto capacity_iter=layerCapacity.Get(layer.id_);
-    if(capacity_iter.first){
-        auto changed_iter=hasChanged.Get(layer.id_);
-        if(!changed_iter.first || !changed_iter.second){
-            return capacity_iter.second;
+ServerStatus SharedFileClient::ReadAt(const Layer &layer, const Descriptor &descriptor, char* data, size_t size, off_t offset) {
+    if(!descriptor.direct) return ReadFully(descriptor.fd,data,size,offset);
+    /* read whole aligned blocks into a bounce buffer and copy out the requested bytes */
+    char* buffer = direct_buffers.Acquire();
+    if(buffer == nullptr) return SERVER_FAILED;
+    ServerStatus status = SERVER_SUCCESS;
+    size_t done = 0;
+    while(done < size && status == SERVER_SUCCESS){
+        off_t position = offset + done;
+        off_t aligned = position / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        size_t skip = position - aligned;
+        size_t length = std::min(size - done, DIRECT_IO_BUFFER_SIZE - skip);
+        size_t block_length = (skip + length + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        ssize_t bytes = pread(descriptor.fd,buffer,block_length,aligned);
+        if(bytes < static_cast<ssize_t>(skip + length)) status = SERVER_FAILED;
+        else{
+            memcpy(data + done,buffer + skip,length);
+            done += length;
         }
     }
-    std::string cmd="du -s "+std::string(layer.layer_loc.c_str())+" | awk {'print$1'}";
-    FILE *fp;
-    std::array<char, 128> buffer;
-    std::string result;
-    FILE* pipe=popen(cmd.c_str(), "r");
-    while(!pipe){
-        sleep(1);
-        pipe=popen(cmd.c_str(), "r");
+    direct_buffers.Release(buffer);
+    return status;
+}
+
+/* fill one aligned block of buffer with the bytes the file holds at aligned, zeros past its end. */
+static ServerStatus ReadBlock(int fd, char* buffer, off_t aligned, off_t file_size){
+    memset(buffer,0,DIRECT_IO_ALIGNMENT);
+    if(aligned >= file_size) return SERVER_SUCCESS;
+    return pread(fd,buffer,DIRECT_IO_ALIGNMENT,aligned) < 0 ? SERVER_FAILED : SERVER_SUCCESS;
+}
+
+ServerStatus SharedFileClient::WriteAt(const Layer &layer, const Descriptor &descriptor, const char* data, size_t size, off_t offset) {
+    if(!descriptor.direct) return WriteFully(descriptor.fd,data,size,offset);
+    struct stat st;
+    if(fstat(descriptor.fd,&st) != 0) return SERVER_FAILED;
+    off_t file_size = st.st_size;
+    char* buffer = direct_buffers.Acquire();
+    if(buffer == nullptr) return SERVER_FAILED;
+    ServerStatus status = SERVER_SUCCESS;
+    size_t done = 0;
+    off_t padded_end = offset;
+    while(done < size && status == SERVER_SUCCESS){
+        off_t position = offset + done;
+        off_t aligned = position / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        size_t skip = position - aligned;
+        size_t length = std::min(size - done, DIRECT_IO_BUFFER_SIZE - skip);
+        size_t block_length = (skip + length + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        /* unaligned edges keep the bytes already in the file, only their two blocks are read back */
+        size_t last_block = block_length - DIRECT_IO_ALIGNMENT;
+        if(skip != 0) status = ReadBlock(descriptor.fd,buffer,aligned,file_size);
+        if(status == SERVER_SUCCESS && block_length != skip + length && (skip == 0 || last_block != 0))
+            status = ReadBlock(descriptor.fd,buffer + last_block,aligned + last_block,file_size);
+        if(status == SERVER_SUCCESS){
+            memcpy(buffer + skip,data + done,length);
+            if(pwrite(descriptor.fd,buffer,block_length,aligned) != static_cast<ssize_t>(block_length)) status = SERVER_FAILED;
+            else{
+                done += length;
+                padded_end = aligned + block_length;
+            }
+        }
     }
-    while (!feof(pipe)) {
-        if (fgets(buffer.data(), 128, pipe) != nullptr)
-            result += buffer.data();
+    direct_buffers.Release(buffer);
+    /* drop the padding of the last block, unless the end of the file moved since it was written */
+    off_t written_end = offset + size;
+    if(status == SERVER_SUCCESS && padded_end > written_end && padded_end > file_size){
+        if(fstat(descriptor.fd,&st) != 0) status = SERVER_FAILED;
+        else if(st.st_size == padded_end && ftruncate(descriptor.fd,std::max(file_size,written_end)) != 0) status = SERVER_FAILED;
     }
-    auto size=std::stoll(result)-4;
-    pclose(pipe);
-    layerCapacity.Put(layer.id_,size);
-    hasChanged.Put(layer.id_,false);
-    return size;
+    return status;
+}
+
+ServerStatus SharedFileClient::Read(PosixFile &source, PosixFile &destination) {
+    AUTO_TRACE("FileClient::Read",source,destination);
+    destination.data.resize(source.GetSize());
+    struct iovec buffer = {destination.data.mutable_data(),destination.data.size()};
+    return SharedFileClient::Read(source,buffer);
+}
+
+ServerStatus SharedFileClient::Read(PosixFile &source, const struct iovec &destination) {
+    AUTO_TRACE("FileClient::Read(iovec)",source,destination.iov_len);
+    auto store = containers->Get(source);
+    if(store != nullptr){
+        size_t size = std::min(static_cast<size_t>(source.GetSize()),destination.iov_len);
+        auto extent = store->Pin(source.file_id);
+        if(!extent.first) return SERVER_FAILED;
+        ServerStatus status = SERVER_FAILED;
+        if(source.segment.start + size <= static_cast<size_t>(extent.second.GetSize())){
+            auto location = store->Locate(source.file_id,extent.second.start + source.segment.start);
+            if(location.first != nullptr) status = ReadAt(source.layer,*location.first,static_cast<char*>(destination.iov_base),size,location.second);
+        }
+        store->Unpin(source.file_id);
+        return status;
+    }
+    auto descriptor = descriptors.Acquire(source.layer,source.file_id,GetFilePath(source),false);
+    if(descriptor == nullptr) return SERVER_FAILED;
+    size_t size = std::min(static_cast<size_t>(source.GetSize()),destination.iov_len);
+    return ReadAt(source.layer,*descriptor,static_cast<char*>(destination.iov_base),size,source.segment.start);
+}
+
+ServerStatus SharedFileClient::Write(PosixFile &source, PosixFile &destination) {
+    AUTO_TRACE("FileClient::Write",source,destination);
+    auto store = containers->Get(destination);
+    if(store != nullptr){
+        size_t size = std::min(static_cast<size_t>(destination.GetSize()),source.data.size());
+        auto extent = store->Reserve(destination.file_id,destination.segment.start + size);
+        if(extent.first != SERVER_SUCCESS) return SERVER_FAILED;
+        auto location = store->Locate(destination.file_id,extent.second + destination.segment.start);
+        ServerStatus status = SERVER_FAILED;
+        if(location.first != nullptr) status = WriteAt(destination.layer,*location.first,source.data.data(),size,location.second);
+        store->Unpin(destination.file_id);
+        return status;
+    }
+    auto descriptor = descriptors.Acquire(destination.layer,destination.file_id,GetFilePath(destination),true);
+    if(descriptor == nullptr) return SERVER_FAILED;
+    long long allocated_before = AllocatedBytes(descriptor->fd);
+    size_t size = std::min(static_cast<size_t>(destination.GetSize()),source.data.size());
+    ServerStatus status = WriteAt(destination.layer,*descriptor,source.data.data(),size,destination.segment.start);
+    ledger->Allocate(destination.layer,AllocatedBytes(descriptor->fd) - allocated_before);
+    return status;
+}
+
+ServerStatus SharedFileClient::Delete(PosixFile &file) {
+    AUTO_TRACE("FileClient::Delete",file);
+    auto store = containers->Get(file);
+    if(store != nullptr) return store->Delete(file.file_id,file.segment);
+    std::string file_path=GetFilePath(file);
+    auto descriptor = descriptors.Acquire(file.layer,file.file_id,file_path,true,false);
+    /* a file that does not exist has nothing left to delete */
+    if(descriptor == nullptr) return errno == ENOENT ? SERVER_SUCCESS : SERVER_FAILED;
+    struct stat st;
+    if(fstat(descriptor->fd,&st) != 0) return SERVER_FAILED;
+    long long allocated_before = static_cast<long long>(st.st_blocks) * 512;
+    off_t start = file.segment.start;
+    off_t end = std::min(static_cast<off_t>(file.segment.end + 1),st.st_size);
+    if(start >= end) return SERVER_SUCCESS;
+    /* offsets of the remaining data stay valid, a suffix is cut and any other range becomes a hole */
+    int status = 0;
+    if(start > 0 || end < st.st_size){
+        if(end == st.st_size) status = ftruncate(descriptor->fd,start);
+        else status = fallocate(descriptor->fd,FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,start,end - start);
+    }
+    /* the file goes once no data is left in it, whether this call or earlier ones removed the rest */
+    bool empty = status == 0 && ((start == 0 && end == st.st_size) || (lseek(descriptor->fd,0,SEEK_DATA) < 0 && errno == ENXIO));
+    if(empty){
+        descriptors.Invalidate(file.layer,file.file_id);
+        unlink(file_path.c_str());
+        ledger->Free(file.layer,allocated_before);
+        return SERVER_SUCCESS;
+    }
+    ledger->Free(file.layer,allocated_before - AllocatedBytes(descriptor->fd));
+    return status == 0 ? SERVER_SUCCESS : SERVER_FAILED;
+}
+
+ServerStatus SharedFileClient::Preallocate(PosixFile &file) {
+    AUTO_TRACE("FileClient::Preallocate",file);
+    auto store = containers->Get(file);
+    if(store == nullptr) return SERVER_SUCCESS;
+    auto extent = store->Reserve(file.file_id,file.segment.end + 1);
+    if(extent.first != SERVER_SUCCESS) return SERVER_FAILED;
+    store->Unpin(file.file_id);
+    return SERVER_SUCCESS;
+}
+
+ServerStatus SharedFileClient::CopyFrom(SharedFileClient &from, PosixFile &source, PosixFile &destination) {
+    AUTO_TRACE("FileClient::CopyFrom",source,destination);
+    if(!from.IsLocal(source) || !IsLocal(destination)) return SERVER_FAILED;
+    size_t remaining = std::min(source.GetSize(),destination.GetSize());
+    /* pin the extent of a source buffer file and reserve the one of a destination buffer file */
+    auto source_store = containers->Get(source);
+    auto destination_store = containers->Get(destination);
+    std::pair<std::shared_ptr<Descriptor>,off_t> input(nullptr,source.segment.start);
+    std::pair<std::shared_ptr<Descriptor>,off_t> output(nullptr,destination.segment.start);
+    bool source_pinned = false, destination_pinned = false;
+    if(source_store != nullptr){
+        auto extent = source_store->Pin(source.file_id);
+        source_pinned = extent.first;
+        if(source_pinned && source.segment.start + remaining <= static_cast<size_t>(extent.second.GetSize()))
+            input = source_store->Locate(source.file_id,extent.second.start + source.segment.start);
+    }else input.first = from.descriptors.Acquire(source.layer,source.file_id,from.GetFilePath(source),false);
+    if(input.first != nullptr){
+        if(destination_store != nullptr){
+            auto extent = destination_store->Reserve(destination.file_id,destination.segment.start + remaining);
+            destination_pinned = extent.first == SERVER_SUCCESS;
+            if(destination_pinned) output = destination_store->Locate(destination.file_id,extent.second + destination.segment.start);
+        }else output.first = descriptors.Acquire(destination.layer,destination.file_id,GetFilePath(destination),true);
+    }
+    ServerStatus status = SERVER_FAILED;
+    if(input.first != nullptr && output.first != nullptr){
+        /* container stores account their own extents, plain files are accounted here */
+        long long allocated_before = destination_store == nullptr ? AllocatedBytes(output.first->fd) : 0;
+        loff_t input_offset = input.second;
+        loff_t output_offset = output.second;
+        status = SERVER_SUCCESS;
+        while(remaining > 0){
+            ssize_t bytes = copy_file_range(input.first->fd,&input_offset,output.first->fd,&output_offset,remaining,0);
+            if(bytes <= 0){
+                status = SERVER_FAILED;
+                break;
+            }
+            remaining -= bytes;
+        }
+        if(destination_store == nullptr) ledger->Allocate(destination.layer,AllocatedBytes(output.first->fd) - allocated_before);
+    }
+    if(destination_pinned) destination_store->Unpin(destination.file_id);
+    if(source_pinned) source_store->Unpin(source.file_id);
+    return status;
+}
+
+double SharedFileClient::GetCurrentUsage(Layer layer) {
+    AUTO_TRACE("FileClient::GetCurrentUsage",layer);
+    return ledger->GetCurrentUsage(layer);
 }
@@ -28,20 +28,53 @@
 
 #include <src/common/distributed_ds/hashmap/DistributedHashMap.h>
 #include <src/common/configuration_manager.h>
+#include <src/common/distributed_ds/dictionary/file_dictionary.h>
 #include "io_client.h"
+#include "tier_ledger.h"
+#include "descriptor_cache.h"
+#include "aligned_buffer_pool.h"
+#include "container_store.h"
 
 class SharedFileClient: public IOClient {
-    DistributedHashMap<uint8_t,bool> hasChanged;
-    DistributedHashMap<uint8_t,double> layerCapacity;
+protected:
+    std::shared_ptr<TierLedger> ledger;
+    std::shared_ptr<FileDictionary> dictionary;
+    /* extents holding the buffer files of the layers */
+    std::shared_ptr<ContainerManager> containers;
+    /* files kept open across reads and writes */
+    DescriptorCache descriptors;
+    /* bounce buffers for layers accessed with O_DIRECT */
+    AlignedBufferPool direct_buffers;
+    /* transfer size bytes at offset of an open file, overridden by clients with another I/O path */
+    virtual ServerStatus ReadAt(const Layer &layer, const Descriptor &descriptor, char* data, size_t size, off_t offset);
+    virtual ServerStatus WriteAt(const Layer &layer, const Descriptor &descriptor, const char* data, size_t size, off_t offset);
+    /* path of the file within its layer */
+    std::string GetFilePath(const PosixFile &file){
+        return std::string(file.layer.layer_loc.c_str())+FILE_SEPARATOR+dictionary->Resolve(file.file_id);
+    }
 public:
-    SharedFileClient():  hasChanged("LAYER_CHANGED",CONF->is_server,CONF->my_server,CONF->num_servers),
-                        layerCapacity("LAYER_CAPACITY",CONF->is_server,CONF->my_server,CONF->num_servers){}
-    SharedFileClient(std::string name):  hasChanged(name+"_LAYER_CHANGED",CONF->is_server,CONF->my_server,CONF->num_servers),
-                         layerCapacity(name+"_LAYER_CAPACITY",CONF->is_server,CONF->my_server,CONF->num_servers){}
+    SharedFileClient():descriptors(),direct_buffers(){
+        ledger = Singleton<TierLedger>::GetInstance("TIER_LEDGER",CONF->is_server,CONF->my_server,CONF->num_servers);
+        dictionary = Singleton<FileDictionary>::GetInstance("FILE_DICTIONARY",CONF->is_server,CONF->my_server,CONF->num_servers);
+        containers = Singleton<ContainerManager>::GetInstance();
+    }
     ServerStatus Read(PosixFile &source, PosixFile &destination) override;
+    ServerStatus Read(PosixFile &source, const struct iovec &destination) override;
     ServerStatus Write(PosixFile &source, PosixFile &destination) override;
-    ServerStatus Delete(PosixFile file) override;
+    ServerStatus Delete(PosixFile &file) override;
+    ServerStatus Preallocate(PosixFile &file) override;
     double GetCurrentUsage(Layer layer) override;
+    /* whether this process can reach the storage holding file directly */
+    virtual bool IsLocal(const PosixFile &file){
+        return true;
+    }
+    /**
+     * Copy source, held by from, into destination inside the kernel with copy_file_range. Buffer
+     * files held in containers are copied between their pinned extents.
+     * @return SERVER_FAILED if either file is not reachable from this process or the kernel
+     *         cannot copy between them; the caller then streams the data instead.
+     */
+    ServerStatus CopyFrom(SharedFileClient &from, PosixFile &source, PosixFile &destination);
 };
 
 
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_TIER_LEDGER_H
+#define HFETCH_TIER_LEDGER_H
+
+#include <atomic>
+#include <mpi.h>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <src/common/constants.h>
+#include <src/common/data_structure.h>
+#include <src/common/debug.h>
+#include <src/common/singleton.h>
+#include <src/common/distributed_ds/communication/rpc_lib.h>
+
+namespace bip=boost::interprocess;
+
+/* used and reserved bytes of one tier. */
+typedef struct TierUsage{
+    std::atomic<long long> used; /* bytes currently held by buffer files of the tier. */
+    std::atomic<long long> reserved; /* bytes promised to placements that are still in flight. */
+    TierUsage():used(0),reserved(0){}
+} TierUsage;
+
+/**
+ * Keeps an exact per-tier space ledger in node shared memory. IO clients update it on every
+ * Write/Delete they perform, so capacity checks are a couple of atomic loads. A tier on a file
+ * system shared by all nodes has one cluster wide count instead, kept by the server its layer id
+ * maps to and updated by the other nodes over RPC; that is also the server evicting it.
+ *
+ * The counts start at zero when the servers start. That matches what HFetch can reach: memory
+ * arenas and container stores are created empty and the auditor indexes no buffered data, so
+ * anything a previous run left in a layer directory is unknown to HFetch and not accounted.
+ * Such leftovers must be removed before the start, or left out of the configured capacity.
+ */
+class TierLedger{
+private:
+    static const size_t MAX_TIERS=256; /* one slot per possible layer id. */
+    static_assert(std::atomic<long long>::is_always_lock_free,"ledger counters must be lock free to live in shared memory");
+    bool is_server;
+    uint16_t my_server;
+    int num_servers;
+    std::string name,func_prefix;
+    std::shared_ptr<RPC> rpc;
+    bip::managed_shared_memory segment;
+    TierUsage* usage;
+
+    /* add to a counter without letting it drop below zero. */
+    static void Add(std::atomic<long long> &counter, long long amount){
+        if(amount >= 0){
+            counter += amount;
+            return;
+        }
+        long long current = counter.load();
+        long long updated;
+        do{
+            updated = current > -amount ? current + amount : 0;
+        }while(!counter.compare_exchange_weak(current,updated));
+    }
+
+    /* server holding the count of the tier. */
+    uint16_t GetOwner(const Layer &layer){
+        return IsShared(layer) ? static_cast<uint16_t>(layer.id_ % num_servers) : my_server;
+    }
+
+    void Update(const Layer &layer, long long used, long long reserved){
+        uint16_t owner = GetOwner(layer);
+        if(owner == my_server) UpdateInServer(layer.id_,used,reserved);
+        else rpc->call(owner,func_prefix+"_Update",layer.id_,used,reserved);
+    }
+
+    std::pair<long long,long long> Get(const Layer &layer){
+        uint16_t owner = GetOwner(layer);
+        if(owner == my_server) return GetInServer(layer.id_);
+        return rpc->call(owner,func_prefix+"_Get",layer.id_).template as<std::pair<long long,long long>>();
+    }
+public:
+    ~TierLedger(){
+        if(is_server) bip::shared_memory_object::remove(name.c_str());
+    }
+    TierLedger(std::string name_, bool is_server_, uint16_t my_server_, int num_servers_)
+            :is_server(is_server_),my_server(my_server_),num_servers(num_servers_),name(name_),func_prefix(name_),segment(),usage(){
+        AUTO_TRACE("TierLedger",name_,is_server_,my_server_,num_servers_);
+        name=name+"_"+std::to_string(my_server);
+        rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",is_server_,my_server_,num_servers_);
+        if(is_server){
+            bip::shared_memory_object::remove(name.c_str());
+            segment=bip::managed_shared_memory(bip::create_only, name.c_str(), 65536);
+            usage = segment.construct<TierUsage>("Usage")[MAX_TIERS]();
+            std::function<void(uint8_t,long long,long long)> updateFunc(std::bind(&TierLedger::UpdateInServer, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            std::function<std::pair<long long,long long>(uint8_t)> getFunc(std::bind(&TierLedger::GetInServer, this, std::placeholders::_1));
+            rpc->bind(func_prefix+"_Update", updateFunc);
+            rpc->bind(func_prefix+"_Get", getFunc);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if(!is_server){
+            segment=bip::managed_shared_memory(bip::open_only,name.c_str());
+            std::pair<TierUsage*,bip::managed_shared_memory::size_type> res;
+            res = segment.find<TierUsage> ("Usage");
+            usage = res.first;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    /* whether the tier is one file system shared by all nodes rather than storage of each node. */
+    static bool IsShared(const Layer &layer){
+        return layer.io_client_type == IOClientType::SHARED_POSIX_FILE;
+    }
+
+    /* apply changes of used and reserved bytes to the counts this server holds. */
+    void UpdateInServer(uint8_t tier, long long used, long long reserved){
+        Add(usage[tier].used,used);
+        Add(usage[tier].reserved,reserved);
+    }
+
+    /* used and reserved bytes of the counts this server holds. */
+    std::pair<long long,long long> GetInServer(uint8_t tier){
+        return std::pair<long long,long long>(usage[tier].used.load(),usage[tier].reserved.load());
+    }
+
+    /* account bytes added to the tier. */
+    void Allocate(const Layer &layer, long long amount){
+        if(amount != 0) Update(layer,amount,0);
+    }
+
+    /* account bytes removed from the tier. */
+    void Free(const Layer &layer, long long amount){
+        if(amount > 0) Update(layer,-amount,0);
+    }
+
+    /* hold bytes for a placement before its data is written. */
+    void Reserve(const Layer &layer, long long amount){
+        if(amount > 0) Update(layer,0,amount);
+    }
+
+    /* release a reservation once the placement finished or failed. */
+    void Release(const Layer &layer, long long amount){
+        if(amount > 0) Update(layer,0,-amount);
+    }
+
+    long long GetUsed(const Layer &layer){
+        return Get(layer).first;
+    }
+
+    long long GetReserved(const Layer &layer){
+        return Get(layer).second;
+    }
+
+    /* used plus reserved bytes, i.e. what is no longer available to new placements. */
+    double GetCurrentUsage(const Layer &layer){
+        auto counts = Get(layer);
+        return counts.first + counts.second;
+    }
+};
+#endif //HFETCH_TIER_LEDGER_H
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_URING_FILE_CLIENT_H
+#define HFETCH_URING_FILE_CLIENT_H
+
+#include <mutex>
+#include <unordered_map>
+#include "local_file_client.h"
+#include "uring_queue.h"
+
+/**
+ * Local file client which moves data through one io_uring queue per layer. A transfer is split
+ * into URING_BUFFER_SIZE operations submitted as one batch, so a segment move keeps up to the
+ * layer's io_queue_depth requests in flight on the device. Falls back to positional I/O where
+ * the kernel does not provide io_uring.
+ */
+class UringFileClient : public LocalFileClient{
+private:
+    std::unordered_map<uint8_t,std::shared_ptr<UringQueue>> queues;
+    std::mutex queues_mutex;
+
+    std::shared_ptr<UringQueue> GetQueue(const Layer &layer){
+        std::lock_guard<std::mutex> lock(queues_mutex);
+        auto iter = queues.find(layer.id_);
+        if(iter != queues.end()) return iter->second;
+        auto queue = std::make_shared<UringQueue>(layer.io_queue_depth);
+        queues.emplace(layer.id_,queue);
+        return queue;
+    }
+protected:
+    ServerStatus ReadAt(const Layer &layer, const Descriptor &descriptor, char* data, size_t size, off_t offset) override {
+        auto queue = GetQueue(layer);
+        if(!queue->IsAvailable()) return SharedFileClient::ReadAt(layer,descriptor,data,size,offset);
+        AUTO_TRACE("UringFileClient::ReadAt",size,offset);
+        size_t alignment = descriptor.direct ? DIRECT_IO_ALIGNMENT : 1;
+        std::vector<UringOp> ops;
+        size_t done = 0;
+        while(done < size){
+            UringOp op;
+            off_t position = offset + done;
+            op.fd = descriptor.fd;
+            op.write = false;
+            op.offset = position / alignment * alignment;
+            op.skip = position - op.offset;
+            op.data = data + done;
+            op.data_length = std::min(size - done, URING_BUFFER_SIZE - op.skip);
+            op.length = (op.skip + op.data_length + alignment - 1) / alignment * alignment;
+            ops.push_back(op);
+            done += op.data_length;
+        }
+        return queue->Submit(ops);
+    }
+
+    ServerStatus WriteAt(const Layer &layer, const Descriptor &descriptor, const char* data, size_t size, off_t offset) override {
+        auto queue = GetQueue(layer);
+        /* unaligned direct writes need the read-modify-write of the synchronous path */
+        bool unaligned = descriptor.direct && (offset % DIRECT_IO_ALIGNMENT != 0 || size % DIRECT_IO_ALIGNMENT != 0);
+        if(!queue->IsAvailable() || unaligned) return SharedFileClient::WriteAt(layer,descriptor,data,size,offset);
+        AUTO_TRACE("UringFileClient::WriteAt",size,offset);
+        std::vector<UringOp> ops;
+        size_t done = 0;
+        while(done < size){
+            UringOp op;
+            op.fd = descriptor.fd;
+            op.write = true;
+            op.offset = offset + done;
+            op.skip = 0;
+            op.data = const_cast<char*>(data) + done;
+            op.data_length = op.length = std::min(size - done, URING_BUFFER_SIZE);
+            ops.push_back(op);
+            done += op.length;
+        }
+        return queue->Submit(ops);
+    }
+public:
+    UringFileClient(): LocalFileClient("URING_FILE_CLIENT"),queues() {
+        AUTO_TRACE("UringFileClient");
+    }
+};
+#endif //HFETCH_URING_FILE_CLIENT_H
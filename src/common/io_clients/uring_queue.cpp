@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <src/common/debug.h>
+#include "uring_queue.h"
+
+UringQueue::UringQueue(unsigned depth_):depth(depth_ > 0 ? depth_ : 1),ring_fd(-1),event_fd(-1),available(false),registered(false),
+                                        sq_ptr(MAP_FAILED),sq_size(0),sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)),sqes_size(0),
+                                        cq_ptr(MAP_FAILED),cq_size(0),buffers(),free_buffers(),pending(),in_flight(0),stop(false){
+    AUTO_TRACE("UringQueue",depth_);
+    available = Setup();
+    if(!available){
+        Teardown();
+        return;
+    }
+    submitter = std::thread(&UringQueue::Run,this);
+}
+
+UringQueue::~UringQueue() {
+    if(available){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        Wake();
+        submitter.join();
+    }
+    Teardown();
+}
+
+bool UringQueue::Setup() {
+    struct io_uring_params params;
+    memset(&params,0,sizeof(params));
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup,depth,&params));
+    if(ring_fd < 0) return false;
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sq_ptr = mmap(nullptr,sq_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,ring_fd,IORING_OFF_SQ_RING);
+    cq_ptr = mmap(nullptr,cq_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,ring_fd,IORING_OFF_CQ_RING);
+    sqes = static_cast<struct io_uring_sqe*>(mmap(nullptr,sqes_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,ring_fd,IORING_OFF_SQES));
+    if(sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED) return false;
+    char* sq = static_cast<char*>(sq_ptr);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ptr);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    /* aligned buffers, so that O_DIRECT descriptors can use the ring as well */
+    std::vector<struct iovec> iovecs;
+    for(unsigned i = 0; i < depth; ++i){
+        void* buffer = nullptr;
+        if(posix_memalign(&buffer,DIRECT_IO_ALIGNMENT,URING_BUFFER_SIZE) != 0) return false;
+        buffers.push_back(static_cast<char*>(buffer));
+        free_buffers.push_back(i);
+        iovecs.push_back(iovec{buffer,URING_BUFFER_SIZE});
+    }
+    /* completions signal event_fd, so the submitter waits for them and for new operations alike */
+    event_fd = eventfd(0,EFD_CLOEXEC);
+    if(event_fd < 0) return false;
+    if(syscall(__NR_io_uring_register,ring_fd,IORING_REGISTER_EVENTFD,&event_fd,1) != 0) return false;
+    /* pinning may exceed the memlock limit, the ring then works on unregistered buffers */
+    registered = syscall(__NR_io_uring_register,ring_fd,IORING_REGISTER_BUFFERS,iovecs.data(),depth) == 0;
+    return true;
+}
+
+void UringQueue::Teardown() {
+    if(sqes != MAP_FAILED) munmap(sqes,sqes_size);
+    if(cq_ptr != MAP_FAILED) munmap(cq_ptr,cq_size);
+    if(sq_ptr != MAP_FAILED) munmap(sq_ptr,sq_size);
+    sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    cq_ptr = sq_ptr = MAP_FAILED;
+    if(ring_fd >= 0) close(ring_fd);
+    ring_fd = -1;
+    if(event_fd >= 0) close(event_fd);
+    event_fd = -1;
+    for(auto buffer:buffers) free(buffer);
+    buffers.clear();
+    free_buffers.clear();
+}
+
+void UringQueue::Wake() {
+    uint64_t one = 1;
+    ssize_t result;
+    do{
+        result = write(event_fd,&one,sizeof(one));
+    }while(result < 0 && errno == EINTR);
+}
+
+void UringQueue::Complete(UringOp* op, int result) {
+    bool failed;
+    if(op->write){
+        failed = result != static_cast<int>(op->length);
+    }else{
+        failed = result < static_cast<int>(op->skip + op->data_length);
+        if(!failed) memcpy(op->data,buffers[op->buffer_index] + op->skip,op->data_length);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_buffers.push_back(op->buffer_index);
+        in_flight--;
+    }
+    UringBatch* batch = op->batch;
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    batch->failed = batch->failed || failed;
+    if(--batch->remaining == 0) batch->completed.notify_all();
+}
+
+void UringQueue::Run() {
+    pthread_setname_np(pthread_self(),"uring");
+    std::vector<UringOp*> ready;
+    while(true){
+        ready.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(stop && pending.empty() && in_flight == 0) return;
+            while(!pending.empty() && !free_buffers.empty()){
+                UringOp* op = pending.front();
+                pending.pop_front();
+                op->buffer_index = free_buffers.back();
+                free_buffers.pop_back();
+                ready.push_back(op);
+                in_flight++;
+            }
+        }
+        /* only this thread touches the submission ring, so the copies and sqes need no lock */
+        unsigned tail = *sq_tail;
+        for(auto op:ready){
+            char* buffer = buffers[op->buffer_index];
+            if(op->write) memcpy(buffer,op->data,op->length);
+            unsigned index = tail & *sq_mask;
+            struct io_uring_sqe* sqe = &sqes[index];
+            memset(sqe,0,sizeof(*sqe));
+            if(registered){
+                sqe->opcode = op->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                sqe->buf_index = static_cast<__u16>(op->buffer_index);
+            }else{
+                sqe->opcode = op->write ? IORING_OP_WRITE : IORING_OP_READ;
+            }
+            sqe->fd = op->fd;
+            sqe->off = static_cast<__u64>(op->offset);
+            sqe->addr = reinterpret_cast<__u64>(buffer);
+            sqe->len = static_cast<__u32>(op->length);
+            sqe->user_data = reinterpret_cast<__u64>(op);
+            sq_array[index] = index;
+            tail++;
+        }
+        if(!ready.empty()){
+            __atomic_store_n(sq_tail,tail,__ATOMIC_RELEASE);
+            long result;
+            do{
+                result = syscall(__NR_io_uring_enter,ring_fd,static_cast<unsigned>(ready.size()),0,0,nullptr,0);
+            }while(result < 0 && errno == EINTR);
+        }
+        unsigned head = *cq_head;
+        bool reaped = false;
+        while(head != __atomic_load_n(cq_tail,__ATOMIC_ACQUIRE)){
+            struct io_uring_cqe* cqe = &cqes[head & *cq_mask];
+            Complete(reinterpret_cast<UringOp*>(cqe->user_data),cqe->res);
+            head++;
+            reaped = true;
+        }
+        __atomic_store_n(cq_head,head,__ATOMIC_RELEASE);
+        if(ready.empty() && !reaped){
+            /* nothing to do until a completion arrives or Submit queues operations */
+            uint64_t events;
+            ssize_t result;
+            do{
+                result = read(event_fd,&events,sizeof(events));
+            }while(result < 0 && errno == EINTR);
+        }
+    }
+}
+
+ServerStatus UringQueue::Submit(std::vector<UringOp> &ops) {
+    AUTO_TRACE("UringQueue::Submit",ops.size());
+    if(ops.empty()) return SERVER_SUCCESS;
+    UringBatch batch;
+    batch.remaining = ops.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto &op:ops){
+            op.batch = &batch;
+            pending.push_back(&op);
+        }
+    }
+    Wake();
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.completed.wait(lock,[&batch]{ return batch.remaining == 0; });
+    return batch.failed ? SERVER_FAILED : SERVER_SUCCESS;
+}
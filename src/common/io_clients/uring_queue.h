@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_URING_QUEUE_H
+#define HFETCH_URING_QUEUE_H
+
+#include <sys/types.h>
+#include <linux/io_uring.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <src/common/constants.h>
+#include <src/common/enumerations.h>
+
+/* completion state shared by the operations of one Submit call. */
+typedef struct UringBatch{
+    std::mutex mutex;
+    std::condition_variable completed;
+    size_t remaining;
+    bool failed;
+    UringBatch():remaining(0),failed(false){}
+} UringBatch;
+
+/**
+ * One transfer of at most URING_BUFFER_SIZE bytes. The device transfers length bytes at offset
+ * through a registered buffer, of which data_length bytes starting at skip are copied from or to
+ * data. For writes skip is 0 and data_length equals length.
+ */
+typedef struct UringOp{
+    int fd;
+    bool write;
+    off_t offset;
+    size_t length;
+    char* data;
+    size_t skip;
+    size_t data_length;
+    UringBatch* batch;
+    int buffer_index;
+} UringOp;
+
+/**
+ * An io_uring instance with depth registered buffers and a single submitter thread. Callers
+ * queue a batch of operations and block until all of them completed; the submitter keeps up to
+ * depth operations of all callers in flight, so concurrent moves share one ring per tier.
+ */
+class UringQueue{
+private:
+    unsigned depth;
+    int ring_fd;
+    /* registered with the ring for completions and written by Submit, the submitter blocks on it */
+    int event_fd;
+    bool available;
+    bool registered; /* buffers registered with the ring, else plain READ/WRITE ops are used */
+    /* submission ring */
+    void* sq_ptr;
+    size_t sq_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    /* completion ring */
+    void* cq_ptr;
+    size_t cq_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    /* registered buffers and the indices of the unused ones */
+    std::vector<char*> buffers;
+    std::vector<int> free_buffers;
+    std::deque<UringOp*> pending;
+    size_t in_flight;
+    bool stop;
+    std::mutex mutex;
+    std::thread submitter;
+
+    bool Setup();
+    void Teardown();
+    void Wake();
+    void Run();
+    void Complete(UringOp* op, int result);
+public:
+    explicit UringQueue(unsigned depth_);
+    ~UringQueue();
+    /* false when the kernel refused io_uring; callers then use synchronous I/O. */
+    bool IsAvailable() const { return available; }
+    /**
+     * Submit the operations and wait until all of them completed.
+     * @return SERVER_FAILED if any operation failed or transferred fewer bytes than required
+     */
+    ServerStatus Submit(std::vector<UringOp> &ops);
+};
+#endif //HFETCH_URING_QUEUE_H
@@ -24,6 +24,8 @@
 
 #ifndef HFETCH_TYPEDEFS_H
 #define HFETCH_TYPEDEFS_H
+#include <cstdint>
 typedef long HTime;
 typedef unsigned long long int really_long;
+typedef uint64_t FileId; /* interned file name, see FileDictionary */
 #endif //HFETCH_TYPEDEFS_H
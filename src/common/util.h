@@ -95,9 +95,12 @@ static struct InputArgs parse_opts(int argc, char *argv[]){
     int comm_size;
     MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
     args.num_workers=1;
+    args.max_prefetch_events=MAX_PREFETCH_EVENTS;
+    args.prefetch_window_us=PREFETCH_WINDOW_US;
+    args.dpe_type=DataPlacementEngineType::MAX_BW;
     args.ranks_per_server_=1;
     args.is_logging=false;
-    while ((opt = getopt (argc, argv, "l:i:f:n:d:r:w:m:s:c:a:p:b:e:")) != -1)
+    while ((opt = getopt (argc, argv, "l:i:f:n:d:r:w:m:s:c:a:p:b:e:t:")) != -1)
     {
         switch (opt)
         {
@@ -113,6 +116,9 @@ static struct InputArgs parse_opts(int argc, char *argv[]){
                     layerInfos[i].is_memory= (bool) atoi(layerInfoStr[2]);
                     strcpy(layerInfos[i].mount_point_, layerInfoStr[3]);
                     layerInfos[i].direct_io= (bool) atoi(layerInfoStr[4]);
+                    /* optional is_local and io_uring queue depth */
+                    layerInfos[i].is_local= layerInfoStr[5] != NULL && (bool) atoi(layerInfoStr[5]);
+                    layerInfos[i].io_queue_depth= layerInfoStr[5] != NULL && layerInfoStr[6] != NULL ? (uint16_t) atoi(layerInfoStr[6]) : 0;
                 }
                 args.layer_count_=layer_count;
                 args.layers=layerInfos;
@@ -162,6 +168,18 @@ static struct InputArgs parse_opts(int argc, char *argv[]){
                 args.num_workers= static_cast<size_t>(atoi(optarg));
                 break;
             }
+            case 'b':{
+                args.max_prefetch_events= static_cast<size_t>(atoi(optarg));
+                break;
+            }
+            case 'e':{
+                args.prefetch_window_us= atol(optarg);
+                break;
+            }
+            case 't':{
+                args.dpe_type= static_cast<DataPlacementEngineType>(atoi(optarg));
+                break;
+            }
             default:{}               /* '?' */
                 /*fprintf (stderr, "Usage: %s [-l layer_count;l(i)_capacity_mb-l(i)_bandwidth-l(i)_is_memory-l(i)_mount_point] [-i io_size_per_request]  [-f pfs_path] [-d direct io true/false] [-n request repetition] [-r ranks_per_server] [-w num_workers]\n", argv[0]);
                 exit (EXIT_FAILURE);*/
@@ -185,21 +203,29 @@ static struct InputArgs parse_opts(int argc, char *argv[]){
         layers[0].bandwidth = 80000;
         layers[0].is_memory = true;
         layers[0].is_local = true;
+        layers[0].direct_io = false;
+        layers[0].io_queue_depth = 0;
         sprintf(layers[1].mount_point_, "%s/nvme/", nvme);
         layers[1].capacity_mb_ = 4*args.io_size_mb/16;
         layers[1].bandwidth = 2000;
         layers[1].is_memory = false;
         layers[1].is_local = true;
+        layers[1].direct_io = false;
+        layers[1].io_queue_depth = 0;
         sprintf(layers[2].mount_point_, "%s/bb/", bb);
         layers[2].capacity_mb_ = 8*args.io_size_mb/16;
         layers[2].bandwidth = 400;
         layers[2].is_memory = false;
         layers[2].is_local = false;
+        layers[2].direct_io = false;
+        layers[2].io_queue_depth = 0;
         sprintf(layers[3].mount_point_, "%s/pfs/", pfs);
         layers[3].capacity_mb_ = args.io_size_mb;
         layers[3].bandwidth = 100;
         layers[3].is_memory = false;
         layers[3].is_local = false;
+        layers[3].direct_io = false;
+        layers[3].io_queue_depth = 0;
         args.layers=layers;
         args.layer_count_=4;
         sprintf(args.pfs_path, "%s", layers[3].mount_point_);
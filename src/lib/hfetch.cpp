@@ -29,7 +29,7 @@
 #include "metadata_manager.h"
 
 FILE *hfetch::fopen(const char *filename, const char *mode) {
-    AutoTrace trace = AutoTrace("hfetch::fopen",filename,mode);
+    AUTO_TRACE("hfetch::fopen",filename,mode);
     auto mdm = Singleton<MetadataManager>::GetInstance();
     auto server = Singleton<Server>::GetInstance();
     FILE* fh = std::fopen(filename,mode);
@@ -40,9 +40,11 @@ FILE *hfetch::fopen(const char *filename, const char *mode) {
     if(!(strcmp(mode,"a")==0 || strcmp(mode,"a+")==0)){
         rewind(fh);
     }
-    mdm->Update(fh,filename);
+    /* events and segment maps only carry the interned id of the file */
+    FileId file_id = Singleton<FileDictionary>::GetInstance("FILE_DICTIONARY",CONF->is_server,CONF->my_server,CONF->num_servers)->Intern(basename(filename));
+    mdm->Update(fh,filename,file_id);
     Event event;
-    event.filename=CharStruct(basename(filename));
+    event.file_id=file_id;
     event.segment.start=0;
     event.segment.end=file_size-1;
     event.layer_index=Layer::LAST->id_;
@@ -53,18 +55,17 @@ FILE *hfetch::fopen(const char *filename, const char *mode) {
 }
 
 int hfetch::fclose(FILE *fh) {
-    AutoTrace trace = AutoTrace("hfetch::fclose");
+    AUTO_TRACE("hfetch::fclose");
     auto mdm = Singleton<MetadataManager>::GetInstance();
     auto server = Singleton<Server>::GetInstance();
-    auto result=mdm->GetFilename(fh);
+    auto result=mdm->GetFileId(fh);
     if(result.first){
-        std::string filename = result.second;
         std::fseek(fh, 0L, SEEK_END);
         long file_size = std::ftell(fh);
         int r = std::fclose(fh);
         mdm->Delete(fh);
         Event event;
-        event.filename=CharStruct(basename(result.second.c_str()));
+        event.file_id=result.second;
         event.segment.start=0;
         event.segment.end=file_size-1;
         event.layer_index=Layer::LAST->id_;
@@ -77,22 +78,22 @@ int hfetch::fclose(FILE *fh) {
 }
 
 int hfetch::fseek(FILE *fh, long int offset, int origin) {
-    AutoTrace trace = AutoTrace("hfetch::fseek");
+    AUTO_TRACE("hfetch::fseek");
     return std::fseek(fh,offset,origin);
 }
 
 size_t hfetch::fread(void *ptr, size_t size, size_t count, FILE *fh) {
     auto mdm = Singleton<MetadataManager>::GetInstance();
     auto server = Singleton<Server>::GetInstance();
-    auto result=mdm->GetFilename(fh);
+    auto result=mdm->GetFileId(fh);
     if(result.first){
-        long current_offset=std::fseek(fh, 0L, SEEK_CUR);
-        AutoTrace trace = AutoTrace("hfetch::fread",current_offset,result.second,size*count);
+        long current_offset=std::ftell(fh);
+        AUTO_TRACE("hfetch::fread",current_offset,result.second,size*count);
         std::fseek(fh, 0L, SEEK_END);
         long file_size = std::ftell(fh);
         std::fseek(fh, current_offset, SEEK_SET);
         Event event;
-        event.filename=CharStruct(basename(result.second.c_str()));
+        event.file_id=result.second;
         event.segment.start=current_offset;
         event.segment.end=current_offset+size*count-1;
         event.layer_index=Layer::LAST->id_;
@@ -100,7 +101,7 @@ size_t hfetch::fread(void *ptr, size_t size, size_t count, FILE *fh) {
         event.event_type=EventType::FILE_READ;
         server->pushEvents(event);
         PosixFile file;
-        file.filename = CharStruct(basename(result.second.c_str()));
+        file.file_id = result.second;
         file.segment = event.segment;
         file.layer = *Layer::LAST;
         auto datas = server->GetDataLocation(file);
@@ -110,13 +111,15 @@ size_t hfetch::fread(void *ptr, size_t size, size_t count, FILE *fh) {
                 CONF->total++;
                 if(data.second.GetSize()>0){
                     if(data.first.layer != *Layer::LAST) CONF->hit++;
-                    data.second.data.reserve(data.second.GetSize());
-                    Singleton<IOClientFactory>::GetInstance()->GetClient(data.first.layer.io_client_type)->Read(data.first,data.second);
-                    memcpy((char*)ptr+original_offset,data.second.data.data(),data.second.GetSize());
+                    /* serve the hit straight into the user buffer */
+                    struct iovec destination = {(char*)ptr+original_offset, static_cast<size_t>(data.second.GetSize())};
+                    Singleton<IOClientFactory>::GetInstance()->GetClient(data.first.layer.io_client_type)->Read(data.first,destination);
                     original_offset+=data.second.GetSize();
                 }
 
             }
+            /* the data did not come through fh, advance it past what was served */
+            std::fseek(fh, current_offset+size*count, SEEK_SET);
         }else{
             std::fread(ptr,size,count,fh);
             CONF->total++;
@@ -128,13 +131,13 @@ size_t hfetch::fread(void *ptr, size_t size, size_t count, FILE *fh) {
 }
 
 size_t hfetch::fwrite(const void *ptr, size_t size, size_t count, FILE *fh) {
-    AutoTrace trace = AutoTrace("hfetch::fwrite",size*count);
+    AUTO_TRACE("hfetch::fwrite",size*count);
     return std::fwrite(ptr,size,count,fh);
 }
 
 InputArgs hfetch::MPI_Init(int *argc, char ***argv) {
     PMPI_Init(argc,argv);
-    AutoTrace trace = AutoTrace("hfetch::MPI_Init");
+    AUTO_TRACE("hfetch::MPI_Init");
     InputArgs args = Server::InitializeClients(*argc,*argv);
     Singleton<MetadataManager>::GetInstance();
     return args;
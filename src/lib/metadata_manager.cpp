@@ -27,29 +27,39 @@
 
 std::pair<bool,std::string> MetadataManager::GetFilename(FILE *fh) {
 
-    AutoTrace trace = AutoTrace(" MetadataManager::GetFilename");
+    AUTO_TRACE(" MetadataManager::GetFilename");
     auto iter = fp_map.find(fh);
     if(iter!=fp_map.end()){
-        return std::pair<bool,std::string>(true,iter->second);
+        return std::pair<bool,std::string>(true,iter->second.first);
     }else{
         return std::pair<bool,std::string>(false,std::string());
     }
 }
 
-ServerStatus MetadataManager::Update(FILE *fh, std::string filename) {
-    AutoTrace trace = AutoTrace(" MetadataManager::Update",filename);
+std::pair<bool,FileId> MetadataManager::GetFileId(FILE *fh) {
+    AUTO_TRACE(" MetadataManager::GetFileId");
+    auto iter = fp_map.find(fh);
+    if(iter!=fp_map.end()){
+        return std::pair<bool,FileId>(true,iter->second.second);
+    }else{
+        return std::pair<bool,FileId>(false,0);
+    }
+}
+
+ServerStatus MetadataManager::Update(FILE *fh, std::string filename, FileId file_id) {
+    AUTO_TRACE(" MetadataManager::Update",filename,file_id);
     auto iter = fp_map.find(fh);
     if(iter!=fp_map.end()){
         fp_map.erase(iter);
-        fp_map.emplace(fh,filename);
+        fp_map.emplace(fh,std::make_pair(filename,file_id));
     }else{
-        fp_map.emplace(fh,filename);
+        fp_map.emplace(fh,std::make_pair(filename,file_id));
     }
     return SERVER_SUCCESS;
 }
 
 ServerStatus MetadataManager::Delete(FILE *fh) {
-    AutoTrace trace = AutoTrace(" MetadataManager::Delete");
+    AUTO_TRACE(" MetadataManager::Delete");
     auto iter = fp_map.find(fh);
     if(iter!=fp_map.end()){
         fp_map.erase(iter);
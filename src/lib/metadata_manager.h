@@ -29,14 +29,16 @@
 #include <cstdio>
 #include <unordered_map>
 #include <src/common/enumerations.h>
+#include <src/common/typedefs.h>
 
 class MetadataManager {\
 private:
-    std::unordered_map<FILE*,std::string> fp_map;
+    std::unordered_map<FILE*,std::pair<std::string,FileId>> fp_map;
 public:
     MetadataManager():fp_map(){}
     std::pair<bool,std::string> GetFilename(FILE* fh);
-    ServerStatus Update(FILE* fh,std::string);
+    std::pair<bool,FileId> GetFileId(FILE* fh);
+    ServerStatus Update(FILE* fh,std::string,FileId);
     ServerStatus Delete(FILE* fh);
 };
 
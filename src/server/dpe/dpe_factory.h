@@ -28,16 +28,20 @@
 #include <src/common/singleton.h>
 #include "dpe.h"
 #include "max_bw_dpe.h"
+#include "read_ahead_dpe.h"
 
 class DPEFactory{
 public:
     DPEFactory(){}
     std::shared_ptr<DPE> GetEngine(DataPlacementEngineType type){
-        AutoTrace trace = AutoTrace("DPEFactory::GetEngine",type);
+        AUTO_TRACE("DPEFactory::GetEngine",type);
         switch (type){
             case DataPlacementEngineType::MAX_BW:{
                 return Singleton<MaxBandwidthDPE>::GetInstance();
             };
+            case DataPlacementEngineType::READ_AHEAD:{
+                return Singleton<ReadAheadDPE>::GetInstance();
+            };
         }
     }
 };
@@ -26,19 +26,18 @@
 #include <tuple>
 
 std::vector<std::tuple<PosixFile, PosixFile,double>> MaxBandwidthDPE::place(std::vector<Event> events) {
-    AutoTrace trace = AutoTrace("MaxBandwidthDPE::place",events);
-    auto layerScore = fileSegmentAuditor->FetchLayerScores();
+    AUTO_TRACE("MaxBandwidthDPE::place",events);
     auto total_placements = std::vector<std::tuple<PosixFile, PosixFile,double>>();
     for(auto event:events){
         if(event.event_type!=EventType::FILE_CLOSE){
             PosixFile file;
-            file.filename=event.filename;
+            file.file_id=event.file_id;
             file.segment=event.segment;
             file.layer=Layer(event.layer_index);
             auto heatMap = fileSegmentAuditor->FetchHeatMap(file);
-            for(auto segment_tuple:heatMap){
-                auto placements = solve(segment_tuple,&layerScore,Layer::FIRST);
-                total_placements.insert(total_placements.end(),placements.begin(),placements.end());
+            for(auto &segment_tuple:heatMap){
+                auto placements = solve(segment_tuple,Layer::FIRST);
+                total_placements.insert(total_placements.end(),std::make_move_iterator(placements.begin()),std::make_move_iterator(placements.end()));
             }
         }
     }
@@ -47,25 +46,24 @@ std::vector<std::tuple<PosixFile, PosixFile,double>> MaxBandwidthDPE::place(std:
 
 std::vector<std::tuple<PosixFile, PosixFile,double>>
 MaxBandwidthDPE::solve(std::tuple<Segment,SegmentScore, PosixFile> segment_tuple,
-                        const std::map<uint8_t, std::multimap<double,std::pair<PosixFile,PosixFile>,std::greater<double>>>* layerScore,
                         Layer* layer,
                         long original_index) {
-    AutoTrace trace = AutoTrace("MaxBandwidthDPE::solve",std::get<0>(segment_tuple),std::get<1>(segment_tuple),std::get<2>(segment_tuple),*layer);
-    double remaining_capacity=layer->capacity_mb_*MB-ioFactory->GetClient(layer->io_client_type)->GetCurrentUsage(*layer);
+    AUTO_TRACE("MaxBandwidthDPE::solve",std::get<0>(segment_tuple),std::get<1>(segment_tuple),std::get<2>(segment_tuple),*layer);
+    double remaining_capacity=layer->capacity_mb_*MB-ledger->GetCurrentUsage(*layer);
     remaining_capacity=remaining_capacity<0?0:remaining_capacity;
     auto final_vector = std::vector<std::tuple<PosixFile, PosixFile,double>>();
     Segment segment = std::get<0>(segment_tuple);
     SegmentScore score_obj = std::get<1>(segment_tuple);
     double score = score_obj.GetScore();
     PosixFile current_file = std::get<2>(segment_tuple);
-    auto layerScoreMap = layerScore->find(layer->id_)->second;
+    auto layerScores = fileSegmentAuditor->GetLayerScores(*layer);
     double layer_min_score = -1*(std::numeric_limits<double>::max()-1);
     double layer_max_score = std::numeric_limits<double>::max();
-    if(layerScoreMap.size() > 0){
-        layer_min_score = layerScoreMap.begin()->first;
-        layer_max_score = layerScoreMap.begin()->first;
+    auto layer_min = layerScores->Min();
+    if(layer_min.first){
+        layer_min_score = layer_min.second;
+        layer_max_score = layerScores->Max().second;
     }
-    if(layerScoreMap.size() > 1) layer_min_score = layerScoreMap.rbegin()->first;
     /* if data already in this layer dont bother. */
     if(current_file.layer == *layer) return final_vector;
     /* if its last layer data is already there as it is prefetching */
@@ -74,8 +72,8 @@ MaxBandwidthDPE::solve(std::tuple<Segment,SegmentScore, PosixFile> segment_tuple
         /* Fits and score is fine too*/
         if(current_file.layer != *layer){
             auto placements=this->PlaceDataInLayer(current_file,*layer,original_index);
-            for(auto placement:placements){
-                final_vector.push_back(std::tuple<PosixFile, PosixFile,double>(placement.first,placement.second,score));
+            for(auto &placement:placements){
+                final_vector.emplace_back(std::move(placement.first),std::move(placement.second),score);
             }
 
         }
@@ -90,41 +88,40 @@ MaxBandwidthDPE::solve(std::tuple<Segment,SegmentScore, PosixFile> segment_tuple
          * which means that some portion of data will fit in current layer and rest has to go to next
          * */
         long space_avail = remaining_capacity;
-        auto iter = layerScoreMap.end();
-        while(iter!=layerScoreMap.begin() && iter->first < score && space_avail <current_file.GetSize()){
-            space_avail += iter->second.second.GetSize();
-            iter--;
+        auto lowest = layerScores->Lowest(score,current_file.GetSize()-space_avail);
+        for(auto entry:lowest){
+            space_avail += entry.second.GetSize();
         }
         if(space_avail > 0){
             /* means case 1 and 2 from above*/
             if(space_avail >= current_file.GetSize()){
                 /* case 1*/
                 auto placements=this->PlaceDataInLayer(current_file,*layer,original_index);
-                for(auto placement:placements)
-                    final_vector.push_back(std::tuple<PosixFile, PosixFile,double>(placement.first,placement.second,score));
+                for(auto &placement:placements)
+                    final_vector.emplace_back(std::move(placement.first),std::move(placement.second),score);
             }else{
                 /* case 2 */
                 std::vector<PosixFile> pieces = dataManager->Split(current_file,space_avail);
                 if(current_file.layer != *layer){
                     auto placements=this->PlaceDataInLayer(pieces[0],*layer,original_index);
-                    for(auto placement:placements)
-                        final_vector.push_back(std::tuple<PosixFile, PosixFile,double>(placement.first,placement.second,score));
+                    for(auto &placement:placements)
+                        final_vector.emplace_back(std::move(placement.first),std::move(placement.second),score);
                 }
-                auto sub_problem = solve(std::tuple<Segment,SegmentScore,PosixFile>(pieces[1].segment,score_obj,pieces[1]),layerScore,layer->next,original_index);
-                final_vector.insert(final_vector.end(),sub_problem.begin(),sub_problem.end());
+                auto sub_problem = solve(std::tuple<Segment,SegmentScore,PosixFile>(pieces[1].segment,score_obj,pieces[1]),layer->next,original_index);
+                final_vector.insert(final_vector.end(),std::make_move_iterator(sub_problem.begin()),std::make_move_iterator(sub_problem.end()));
             }
         }
     }else{
         /* do next layer */
-        auto sub_problem=solve(segment_tuple,layerScore,layer->next,original_index);
-        final_vector.insert(final_vector.end(),sub_problem.begin(),sub_problem.end());
+        auto sub_problem=solve(segment_tuple,layer->next,original_index);
+        final_vector.insert(final_vector.end(),std::make_move_iterator(sub_problem.begin()),std::make_move_iterator(sub_problem.end()));
     }
 
     return final_vector;
 }
 
 bool MaxBandwidthDPE::IsAllowed(double score, double min_score, double max_score) {
-    AutoTrace trace = AutoTrace("MaxBandwidthDPE::IsAllowed",score,min_score,max_score);
+    AUTO_TRACE("MaxBandwidthDPE::IsAllowed",score,min_score,max_score);
     return score > min_score;
 }
 
@@ -141,12 +138,12 @@ std::vector<pair<PosixFile, PosixFile>> MaxBandwidthDPE::PlaceDataInLayer(PosixF
     std::vector<PosixFile> buf_pieces=SplitInParts(destination,current_file.layer == *Layer::LAST);
     auto placements = std::vector<pair<PosixFile, PosixFile>>();
     for(int i=0;i<buf_pieces.size();++i){
-        placements.push_back(pair<PosixFile, PosixFile>(original_pieces[i],buf_pieces[i]));
+        placements.emplace_back(std::move(original_pieces[i]),std::move(buf_pieces[i]));
     }
     return placements;
 }
 
-vector<PosixFile> MaxBandwidthDPE::SplitInParts(PosixFile file, bool generateName) {
+vector<PosixFile> MaxBandwidthDPE::SplitInParts(const PosixFile &file, bool generateName) {
     int parts=file.GetSize()/SEGMENT_SIZE;
     parts += (file.GetSize()%SEGMENT_SIZE==0?0:1);
     int original_index=file.segment.start;
@@ -157,10 +154,10 @@ vector<PosixFile> MaxBandwidthDPE::SplitInParts(PosixFile file, bool generateNam
         PosixFile piece=file;
         piece.segment.start=original_index;
         piece.segment.end=original_index + (left_size<SEGMENT_SIZE?left_size:SEGMENT_SIZE)-1;
-        if(generateName) piece.filename = dataManager->GenerateBufferFilename();
+        if(generateName) piece.file_id = dataManager->GenerateBufferFileId();
         if(!generateName)  original_index = piece.segment.end+1;
-        pieces.push_back(piece);
         left_size-=piece.GetSize();
+        pieces.push_back(std::move(piece));
     }
     return pieces;
 }
@@ -34,16 +34,17 @@ class MaxBandwidthDPE: public DPE {
     std::shared_ptr<FileSegmentAuditor> fileSegmentAuditor;
     std::shared_ptr<IOClientFactory> ioFactory;
     std::shared_ptr<DataManager> dataManager;
+    std::shared_ptr<TierLedger> ledger;
 public:
     MaxBandwidthDPE(){
         fileSegmentAuditor = Singleton<FileSegmentAuditor>::GetInstance();
         ioFactory = Singleton<IOClientFactory>::GetInstance();
         dataManager = Singleton<DataManager>::GetInstance();
+        ledger = Singleton<TierLedger>::GetInstance("TIER_LEDGER",CONF->is_server,CONF->my_server,CONF->num_servers);
     }
     std::vector<std::tuple<PosixFile, PosixFile,double>> place(std::vector<Event> events) override;
 
     std::vector<std::tuple<PosixFile, PosixFile,double>> solve(std::tuple<Segment,SegmentScore, PosixFile> segment_tuple,
-                                                       const std::map<uint8_t, std::multimap<double,std::pair<PosixFile,PosixFile>,std::greater<double>>>* layerScore,
                                                        Layer* layer,
                                                        long original_index=0);
 
@@ -51,7 +52,7 @@ public:
 
     std::vector<pair<PosixFile, PosixFile>> PlaceDataInLayer(PosixFile &file, Layer &layer, long &original_index);
 
-    vector<PosixFile> SplitInParts(PosixFile file, bool b);
+    vector<PosixFile> SplitInParts(const PosixFile &file, bool b);
 };
 
 
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#include "read_ahead_dpe.h"
+#include <algorithm>
+#include <tuple>
+
+/* record the size of a read and return the median of the recent ones. */
+long ReadAheadDPE::GetRequestSize(Stream &stream, long size) {
+    stream.sizes[stream.reads % READ_AHEAD_SIZE_HISTORY] = size;
+    ++stream.reads;
+    size_t count = std::min(stream.reads,READ_AHEAD_SIZE_HISTORY);
+    std::array<long,READ_AHEAD_SIZE_HISTORY> sorted = stream.sizes;
+    std::nth_element(sorted.begin(),sorted.begin() + count/2,sorted.begin() + count);
+    return sorted[count/2];
+}
+
+std::vector<Segment> ReadAheadDPE::Predict(Stream &stream, const Event &event) {
+    AUTO_TRACE("ReadAheadDPE::Predict",event);
+    std::vector<Segment> predictions = std::vector<Segment>();
+    Segment current = event.segment;
+    long size = GetRequestSize(stream,current.GetSize());
+    if(!stream.has_last){
+        stream.has_last = true;
+        stream.last = current;
+        stream.issued_until = current.start;
+        return predictions;
+    }
+    /* a sequential stream continues after the end of the last read, whatever the size of that event */
+    bool sequential = current.start == stream.last.end + 1;
+    long stride = sequential ? size : current.start - stream.last.start;
+    if(sequential || (stride > 0 && stride == stream.stride)){
+        /* prediction hit: grow the window */
+        stream.window = std::min(stream.window*2,READ_AHEAD_MAX_WINDOW);
+        stream.stride = stride;
+    }else{
+        /* pattern broken: shrink the window and forget what was issued for the old pattern */
+        stream.window = std::max(stream.window/2,READ_AHEAD_INITIAL_WINDOW);
+        stream.stride = stride;
+        stream.last = current;
+        stream.issued_until = current.start;
+        return predictions;
+    }
+    stream.last = current;
+    /* predicted reads follow the end of a sequential read and the start of a strided one */
+    long base = sequential ? static_cast<long>(current.end) + 1 - stride : current.start;
+    if(stream.issued_until < base) stream.issued_until = base;
+    for(size_t i = 1; i <= stream.window; ++i){
+        long start = base + i*stride;
+        if(stream.file_size >= 0 && start >= stream.file_size) break;
+        if(start <= stream.issued_until) continue;
+        long end = start + size - 1;
+        if(stream.file_size >= 0 && end >= stream.file_size) end = stream.file_size - 1;
+        predictions.push_back(Segment(start,end));
+        stream.issued_until = start;
+    }
+    return predictions;
+}
+
+std::vector<std::tuple<PosixFile, PosixFile,double>> ReadAheadDPE::place(std::vector<Event> events) {
+    AUTO_TRACE("ReadAheadDPE::place",events);
+    auto total_placements = std::vector<std::tuple<PosixFile, PosixFile,double>>();
+    auto predictions = std::vector<std::pair<Event,std::vector<Segment>>>();
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex);
+        for(auto event:events){
+            switch(event.event_type){
+                case EventType::FILE_OPEN:{
+                    Stream &stream = streams[event.file_id];
+                    stream.file_size = event.segment.end + 1;
+                    break;
+                }
+                case EventType::FILE_CLOSE:{
+                    streams.erase(event.file_id);
+                    break;
+                }
+                case EventType::FILE_READ:{
+                    auto segments = Predict(streams[event.file_id],event);
+                    if(!segments.empty()) predictions.push_back(std::pair<Event,std::vector<Segment>>(event,segments));
+                    break;
+                }
+                case EventType::FILE_WRITE:{
+                    /* writes leave the read pattern alone but may extend the file the predictions stop at */
+                    auto iter = streams.find(event.file_id);
+                    if(iter != streams.end() && iter->second.file_size >= 0)
+                        iter->second.file_size = std::max(iter->second.file_size,static_cast<long>(event.segment.end) + 1);
+                    break;
+                }
+            }
+        }
+    }
+    if(predictions.empty()) return total_placements;
+    for(auto prediction:predictions){
+        Event event = prediction.first;
+        /* predicted reads are scored as if they were read right after the read that predicted them */
+        SegmentScore score;
+        score.frequency = 1;
+        score.lrf = pow(.5,LAMDA_FOR_SCORE*event.time/1000000.0);
+        for(auto segment:prediction.second){
+            PosixFile file;
+            file.file_id = event.file_id;
+            file.segment = segment;
+            file.layer = *Layer::LAST;
+            auto placements = maxBandwidthDPE->solve(std::tuple<Segment,SegmentScore,PosixFile>(segment,score,file),
+                                                     Layer::FIRST,segment.start);
+            total_placements.insert(total_placements.end(),std::make_move_iterator(placements.begin()),std::make_move_iterator(placements.end()));
+        }
+    }
+    return total_placements;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_READ_AHEAD_DPE_H
+#define HFETCH_READ_AHEAD_DPE_H
+
+
+#include <array>
+#include <mutex>
+#include <unordered_map>
+#include <src/server/file_segment_auditor.h>
+#include <src/common/io_clients/data_manager.h>
+#include "dpe.h"
+#include "max_bw_dpe.h"
+
+/**
+ * Prefetches data the application has not touched yet. Every file read by the application is tracked as a
+ * stream. Once a read starts right after the previous one, or two consecutive reads are the same distance apart,
+ * the next reads of the pattern are placed ahead of the application. Adjacent reads may arrive coalesced into one
+ * event, so predicted reads take the median size of the recent reads of the stream rather than the last one. The read-ahead window doubles while predictions hit and is
+ * halved on a miss. The tier of each prefetched segment is chosen by the max bandwidth engine.
+ */
+class ReadAheadDPE: public DPE {
+    /* access pattern of one file */
+    typedef struct Stream{
+        long file_size; /* size recorded on open, -1 if unknown */
+        Segment last; /* last segment read */
+        long stride; /* distance between the starts of the last two reads */
+        long issued_until; /* start of the furthest read already prefetched */
+        size_t window; /* number of reads to keep prefetched ahead */
+        std::array<long,READ_AHEAD_SIZE_HISTORY> sizes; /* sizes of the last reads, oldest overwritten first */
+        size_t reads; /* reads seen so far */
+        bool has_last;
+        Stream():file_size(-1),last(),stride(0),issued_until(-1),window(READ_AHEAD_INITIAL_WINDOW),sizes(),reads(0),
+                 has_last(false){}
+    } Stream;
+
+    std::shared_ptr<MaxBandwidthDPE> maxBandwidthDPE;
+    std::unordered_map<FileId,Stream> streams;
+    std::mutex streams_mutex;
+
+    static long GetRequestSize(Stream &stream, long size);
+    std::vector<Segment> Predict(Stream &stream, const Event &event);
+public:
+    ReadAheadDPE():streams(){
+        AUTO_TRACE("ReadAheadDPE");
+        maxBandwidthDPE = Singleton<MaxBandwidthDPE>::GetInstance();
+    }
+    std::vector<std::tuple<PosixFile, PosixFile,double>> place(std::vector<Event> events) override;
+};
+
+
+#endif //HFETCH_READ_AHEAD_DPE_H
@@ -26,34 +26,38 @@
 
 
 ServerStatus EventManager::handle(std::vector<Event> events) {
-    AutoTrace trace = AutoTrace("EventManager::handle",events);
+    AUTO_TRACE("EventManager::handle",events);
     auditor->Update(events);
-    auto placements = dpe->place(events);
-    for(auto placement : placements){
-        PosixFile source=std::get<0>(placement);
-        PosixFile destination=std::get<1>(placement);
-        double score=std::get<2>(placement);
-        if(!dataManager->HasCapacity(destination.GetSize(),destination.layer)){
-            dataManager->MakeCapacity(destination.GetSize(),score,destination.layer);
+    for(auto event:events){
+        /* placed one event at a time so every move is tracked under the original file it belongs to */
+        auto placements = dpe->place(std::vector<Event>(1,event));
+        for(auto &placement : placements){
+            movementEngine->Submit(event.file_id,std::get<0>(placement),std::get<1>(placement),std::get<2>(placement));
         }
-        dataManager->Prefetch(source,destination);
-        auditor->UpdateOnMove(source,destination);
     }
     for(auto event:events){
         if(event.event_type==EventType::FILE_CLOSE){
             PosixFile file;
-            file.filename=event.filename;
+            file.file_id=event.file_id;
             file.segment=event.segment;
             file.layer=Layer(event.layer_index);
             bool isFileActive = auditor->CheckIfFileActive(file);
             if(!isFileActive){
-                auto heatMap = auditor->FetchHeatMap(file);
-                for(auto segment_tuple:heatMap){
-                    PosixFile buf_file=std::get<2>(segment_tuple);
-                    if(buf_file.layer!=*Layer::LAST) ioFactory->GetClient(buf_file.layer.io_client_type)->Delete(buf_file);
-                }
+                /* buffers of the file may still be written by in-flight moves, drop them once those are done */
+                dataManager->OnMovesCompleted(file.file_id,[this,file](){ DeleteBuffers(file); });
             }
         }
     }
     return SERVER_SUCCESS;
 }
+
+void EventManager::DeleteBuffers(PosixFile file) {
+    AUTO_TRACE("EventManager::DeleteBuffers",file);
+    /* the file may have been opened again while its moves finished */
+    if(auditor->CheckIfFileActive(file)) return;
+    auto heatMap = auditor->FetchHeatMap(file);
+    for(auto &segment_tuple:heatMap){
+        PosixFile &buf_file=std::get<2>(segment_tuple);
+        if(buf_file.layer!=*Layer::LAST) ioFactory->GetClient(buf_file.layer.io_client_type)->Delete(buf_file);
+    }
+}
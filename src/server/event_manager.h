@@ -34,19 +34,24 @@
 #include <src/server/dpe/dpe_factory.h>
 #include <src/common/io_clients/data_manager.h>
 #include "file_segment_auditor.h"
+#include "movement_engine.h"
 
 class EventManager {
     std::shared_ptr<FileSegmentAuditor> auditor;
     std::shared_ptr<DPE> dpe;
     std::shared_ptr<DataManager> dataManager;
     std::shared_ptr<IOClientFactory> ioFactory;
+    std::shared_ptr<MovementEngine> movementEngine;
+
+    void DeleteBuffers(PosixFile file);
 public:
     EventManager(){
-        AutoTrace trace = AutoTrace("EventManager");
+        AUTO_TRACE("EventManager");
         ioFactory = Singleton<IOClientFactory>::GetInstance();
         auditor = Singleton<FileSegmentAuditor>::GetInstance();
         dpe = Singleton<DPEFactory>::GetInstance()->GetEngine(CONF->dpeType);
         dataManager = Singleton<DataManager>::GetInstance();
+        movementEngine = Singleton<MovementEngine>::GetInstance();
     }
     ServerStatus handle(std::vector<Event> events);
 };
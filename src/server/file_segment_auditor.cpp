@@ -27,11 +27,11 @@
 
 ServerStatus FileSegmentAuditor::Update(std::vector<Event> events) {
 
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::Update",events);
+    AUTO_TRACE("FileSegmentAuditor::Update",events);
     for(auto event : events){
         switch(event.event_type){
             case EventType::FILE_OPEN:{
-                auto file_iter = file_segment_map.find(event.filename);
+                auto file_iter = file_segment_map.find(event.file_id);
                 if(file_iter == file_segment_map.end()){
                     CreateOffsetMap(event);
                 }
@@ -51,43 +51,29 @@ ServerStatus FileSegmentAuditor::Update(std::vector<Event> events) {
     return SERVER_SUCCESS;
 }
 
-ServerStatus FileSegmentAuditor::UpdateOnMove(PosixFile source, PosixFile destination) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::UpdateOnMove",source,destination);
-    auto iter = file_segment_map.find(source.filename);
+ServerStatus FileSegmentAuditor::UpdateOnMove(const PosixFile &source, const PosixFile &destination) {
+    AUTO_TRACE("FileSegmentAuditor::UpdateOnMove",source,destination);
+    auto iter = file_segment_map.find(source.file_id);
     if(iter != file_segment_map.end()){
         std::shared_ptr<SegmentMap> multiMapScore = iter->second;
-        auto iter = multiMapScore->Get(source.segment);
         auto allDatas = multiMapScore->Contains(source.segment);
         for(auto elements : allDatas){
             multiMapScore->Erase(elements.first);
+            auto score = elements.second.second.GetScore();
+            UnindexExtent(source.file_id,elements.first,elements.second.first.layer);
             /* retain left over scores */
             auto left_overs = elements.first.Substract(source.segment);
             for(auto left_over : left_overs){
                 multiMapScore->Put(left_over,elements.second);
+                IndexExtent(source.file_id,left_over,elements.first,elements.second.first,score);
             }
             /* update intersected score */
             auto common = source.segment.Intersect(elements.first);
-            auto previous_score = elements.second.second.GetScore();
             elements.second.first = destination;
             elements.second.first.segment.start = common.start - source.segment.start;
             elements.second.first.segment.end = common.end - source.segment.start;
             multiMapScore->Put(common,elements.second);
-            auto layer_score_iter = layer_score_map.Get(elements.second.first.layer.id_);
-            if(layer_score_iter.first){
-                auto ret = layer_score_iter.second.equal_range(previous_score);
-                auto it=ret.first;
-                while( it!=ret.second){
-                    if(it->second.first.filename == source.filename && it->second.first.segment == elements.first){
-                        it = layer_score_iter.second.erase(it);
-                    }else ++it;
-                }
-                PosixFile sub_buf=elements.second.first;
-                PosixFile sub_source=source;
-                sub_source.segment = common;
-                sub_buf.segment = common;
-                layer_score_iter.second.emplace(elements.second.second.GetScore(),std::pair<PosixFile,PosixFile>(sub_source,sub_buf));
-                layer_score_map.Put(elements.second.first.layer.id_,layer_score_iter.second);
-            }
+            IndexExtent(source.file_id,common,common,elements.second.first,score);
         }
     }
 
@@ -95,97 +81,119 @@ ServerStatus FileSegmentAuditor::UpdateOnMove(PosixFile source, PosixFile destin
 }
 
 ServerStatus FileSegmentAuditor::MarkFileSegmentsActive(Event event) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::MarkFileSegmentsActive",event);
-    auto iter = file_active_status.Get(event.filename);
-    if(iter.first){
-        file_active_status.Put(event.filename,iter.second + 1);
-    }else{
-        file_active_status.Put(event.filename,1);
-    }
+    AUTO_TRACE("FileSegmentAuditor::MarkFileSegmentsActive",event);
+    file_active_status.Increment(event.file_id,1);
     return SERVER_SUCCESS;
 }
 
 ServerStatus FileSegmentAuditor::MarkFileSegmentsInactive(Event event) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::MarkFileSegmentsInactive",event);
-    auto iter = file_active_status.Get(event.filename);
-    if(iter.first){
-        file_active_status.Put(event.filename,iter.second - 1);
-    }
+    AUTO_TRACE("FileSegmentAuditor::MarkFileSegmentsInactive",event);
+    file_active_status.Merge(event.file_id,DECREMENT_ACTIVE,1);
     return SERVER_SUCCESS;
 }
 
+bool FileSegmentAuditor::DecrementActive(bool exists, uint32_t &value, const uint32_t &delta) {
+    /* a close without a tracked open must neither create the entry nor wrap the count */
+    if(!exists) return false;
+    value = value > delta ? value - delta : 0;
+    return true;
+}
+
+bool FileSegmentAuditor::AddScore(bool exists, std::pair<PosixFile,SegmentScore> &value, const std::pair<PosixFile,SegmentScore> &delta) {
+    if(!exists) return false;
+    value.second.frequency+=delta.second.frequency;
+    value.second.lrf+=delta.second.lrf;
+    return true;
+}
+
 ServerStatus FileSegmentAuditor::IncreaseFileSegmentFrequency(Event event) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::IncreaseFileSegmentFrequency",event);
-    auto iter = file_segment_map.find(event.filename);
+    AUTO_TRACE("FileSegmentAuditor::IncreaseFileSegmentFrequency",event);
+    auto iter = file_segment_map.find(event.file_id);
     if(iter != file_segment_map.end()){
         std::shared_ptr<SegmentMap> multiMapScore = iter->second;
-        auto allDatas = multiMapScore->Contains(event.segment);
+        std::pair<PosixFile,SegmentScore> delta;
+        delta.second.frequency=1;
+        delta.second.lrf=pow(.5,LAMDA_FOR_SCORE*event.time/1000000.0);
+        /* split and score update happen on the owner in one call, only the layer indexes are updated here */
+        auto allDatas = multiMapScore->MergeOverlapping(event.segment,ADD_SCORE,delta);
         for(auto elements : allDatas){
-            multiMapScore->Erase(elements.first);
+            auto previous_score = elements.second.second.GetScore();
             /* retain left over scores */
             auto left_overs = elements.first.Substract(event.segment);
+            if(!left_overs.empty()) UnindexExtent(event.file_id,elements.first,elements.second.first.layer);
             for(auto left_over : left_overs){
-                multiMapScore->Put(left_over,elements.second);
+                IndexExtent(event.file_id,left_over,elements.first,elements.second.first,previous_score);
             }
             /* update intersected score */
             auto common = event.segment.Intersect(elements.first);
-            auto previous_score = elements.second.second.GetScore();
-            elements.second.second.frequency+=1;
-            elements.second.second.lrf+=pow(.5,LAMDA_FOR_SCORE*event.time/1000000.0);
+            AddScore(true,elements.second,delta);
             double newScore = elements.second.second.GetScore();
-            /*printf("File:%s,%ld,%ld Score:%f\n",
-                    event.filename.c_str(),
-                    elements.second.first.segment.start,
-                    elements.second.first.segment.end,
-                    newScore);*/
-            multiMapScore->Put(common,elements.second);
-            auto layer_score_iter = layer_score_map.Get(elements.second.first.layer.id_);
-            if(layer_score_iter.first){
-                auto ret = layer_score_iter.second.equal_range(previous_score);
-                auto it=ret.first;
-                while( it!=ret.second){
-                    if(it->second.first.filename == event.filename && it->second.first.segment == elements.first){
-                        it = layer_score_iter.second.erase(it);
-                    }else ++it;
-                }
-                PosixFile sub_buf=elements.second.first;
-                sub_buf.segment = common;
-                PosixFile sub_source;
-                sub_source.filename=event.filename;
-                sub_source.layer=Layer(event.layer_index);
-                sub_source.segment = common;
-                layer_score_iter.second.emplace(elements.second.second.GetScore(),std::pair<PosixFile,PosixFile>(sub_source,sub_buf));
-                layer_score_map.Put(elements.second.first.layer.id_,layer_score_iter.second);
+            auto layer_scores_iter = layer_scores.find(elements.second.first.layer.id_);
+            if(left_overs.empty() && layer_scores_iter != layer_scores.end()
+               && layer_scores_iter->second->UpdateScore(std::pair<FileId,Segment>(event.file_id,common),newScore)){
+                continue;
             }
+            IndexExtent(event.file_id,common,elements.first,elements.second.first,newScore);
         }
     }
     return SERVER_SUCCESS;
 }
 
+ServerStatus FileSegmentAuditor::IndexExtent(FileId file_id, Segment extent, Segment located_extent, PosixFile location, double score) {
+    AUTO_TRACE("FileSegmentAuditor::IndexExtent",file_id,extent,located_extent,location,score);
+    auto iter = layer_scores.find(location.layer.id_);
+    if(iter == layer_scores.end()) return SERVER_FAILED;
+    /* location holds located_extent, extent is a part of it */
+    BufferedSegment buffered;
+    buffered.file_id = file_id;
+    buffered.segment = extent;
+    buffered.buffer_id = location.file_id;
+    buffered.buffer_segment.start = location.segment.start + extent.start - located_extent.start;
+    buffered.buffer_segment.end = buffered.buffer_segment.start + extent.GetSize() - 1;
+    buffered.layer_id = location.layer.id_;
+    buffered.server = GetHoldingServer(location);
+    iter->second->Insert(std::pair<FileId,Segment>(file_id,extent),score,buffered);
+    return SERVER_SUCCESS;
+}
+
+/* the server whose evictor frees location: the one storing it, or a fixed one for a tier shared by all nodes */
+uint16_t FileSegmentAuditor::GetHoldingServer(const PosixFile &location) {
+    if(TierLedger::IsShared(location.layer)) return static_cast<uint16_t>(location.layer.id_ % CONF->num_servers);
+    return static_cast<uint16_t>(std::hash<FileId>()(location.file_id) % CONF->num_servers);
+}
+
+ServerStatus FileSegmentAuditor::UnindexExtent(FileId file_id, Segment extent, Layer layer) {
+    AUTO_TRACE("FileSegmentAuditor::UnindexExtent",file_id,extent,layer);
+    auto iter = layer_scores.find(layer.id_);
+    if(iter == layer_scores.end()) return SERVER_FAILED;
+    iter->second->Remove(std::pair<FileId,Segment>(file_id,extent));
+    return SERVER_SUCCESS;
+}
+
 ServerStatus FileSegmentAuditor::CreateOffsetMap(Event event) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::CreateOffsetMap",event);
-    auto file_iter = file_segment_map.find(event.filename);
+    AUTO_TRACE("FileSegmentAuditor::CreateOffsetMap",event);
+    auto file_iter = file_segment_map.find(event.file_id);
     if(file_iter == file_segment_map.end()){
-        std::string name(event.filename.c_str());
-        auto iter = valid_buffered_dataset.Get(name);
+        auto iter = valid_buffered_dataset.Get(event.file_id);
         uint64_t sequence;
         if(iter.first){
             sequence = iter.second;
             std::shared_ptr<SegmentMap> mapLayer = offsetMaps[sequence];
-            file_segment_map.emplace(event.filename,mapLayer);
+            file_segment_map.emplace(event.file_id,mapLayer);
         }else{
+            /* slots are taken in cluster wide order, so one is reused only after max_num_files others */
             sequence = file_seq.GetNextSequenceServer(0)% CONF->max_num_files;
-            valid_buffered_dataset.Put(name,sequence);
+            valid_buffered_dataset.Put(event.file_id,sequence);
             std::shared_ptr<SegmentMap> mapLayer = offsetMaps[sequence];
             SegmentScore score;
             score.frequency=0;
             score.lrf=0;
             PosixFile file;
-            file.filename = event.filename;
+            file.file_id = event.file_id;
             file.segment = event.segment;
             file.layer = Layer(event.layer_index);
             mapLayer->Put(event.segment,std::pair<PosixFile,SegmentScore>(file,score));
-            file_segment_map.emplace(event.filename,mapLayer);
+            file_segment_map.emplace(event.file_id,mapLayer);
         }
 
     }
@@ -193,12 +201,12 @@ ServerStatus FileSegmentAuditor::CreateOffsetMap(Event event) {
 }
 
 std::vector<std::tuple<Segment,SegmentScore, PosixFile>> FileSegmentAuditor::FetchHeatMap(PosixFile file) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::FetchHeatMap",file);
+    AUTO_TRACE("FileSegmentAuditor::FetchHeatMap",file);
     typedef std::multimap<SegmentScore,std::pair<Segment,PosixFile>> MM;
     typedef std::vector<std::tuple<Segment,SegmentScore, PosixFile>> VT;
     VT vector_tuple=VT();
     MM sorted_map=MM();
-    auto iter = file_segment_map.find(file.filename);
+    auto iter = file_segment_map.find(file.file_id);
 
     if(iter != file_segment_map.end()){
         std::shared_ptr<SegmentMap> map = iter->second;
@@ -213,20 +221,15 @@ std::vector<std::tuple<Segment,SegmentScore, PosixFile>> FileSegmentAuditor::Fet
     return vector_tuple;
 }
 
-std::map<uint8_t, std::multimap<double,std::pair<PosixFile,PosixFile>,std::greater<double>>> FileSegmentAuditor::FetchLayerScores() {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::FetchLayerScores");
-    auto allDatas=layer_score_map.GetAllData();
-    auto return_map=std::map<uint8_t, std::multimap<double,std::pair<PosixFile,PosixFile>,std::greater<double>>>();
-    for(auto data:allDatas){
-        return_map.emplace(data.first,data.second);
-    }
-    return return_map;
+std::shared_ptr<LayerScoreIndex> FileSegmentAuditor::GetLayerScores(Layer layer) {
+    AUTO_TRACE("FileSegmentAuditor::GetLayerScores",layer);
+    return layer_scores.find(layer.id_)->second;
 }
 
 std::vector<std::pair<PosixFile, PosixFile>> FileSegmentAuditor::GetDataLocation(PosixFile file) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::GetDataLocation",file);
+    AUTO_TRACE("FileSegmentAuditor::GetDataLocation",file);
     std::vector<std::pair<PosixFile, PosixFile>> values = std::vector<std::pair<PosixFile, PosixFile>>();
-    auto iter = valid_buffered_dataset.Get(file.filename);
+    auto iter = valid_buffered_dataset.Get(file.file_id);
     long original_start=0;
     if(iter.first){
         std::shared_ptr<SegmentMap> map = offsetMaps[iter.second];
@@ -249,8 +252,8 @@ std::vector<std::pair<PosixFile, PosixFile>> FileSegmentAuditor::GetDataLocation
 
 
 bool FileSegmentAuditor::CheckIfFileActive(PosixFile file) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::CheckIfFileActive",file);
-    auto iter = file_active_status.Get(file.filename);
+    AUTO_TRACE("FileSegmentAuditor::CheckIfFileActive",file);
+    auto iter = file_active_status.Get(file.file_id);
     if(iter.first){
         return iter.second != 0;
     }
@@ -258,7 +261,7 @@ bool FileSegmentAuditor::CheckIfFileActive(PosixFile file) {
 }
 
 ServerStatus FileSegmentAuditor::CallCreateOffsetRPC(uint16_t server, Event event) {
-    AutoTrace trace = AutoTrace("FileSegmentAuditor::CallCreateOffsetRPC",server,event);
+    AUTO_TRACE("FileSegmentAuditor::CallCreateOffsetRPC",server,event);
     rpc->call(server,FILE_SEGMENT_AUDITOR+"_CreateOffsetMap",event);
     return SERVER_SUCCESS;
 }
@@ -30,61 +30,74 @@
 #include <src/common/distributed_ds/map/DistributedMap.h>
 #include <src/common/distributed_ds/multimap/DistributedMultiMap.h>
 #include <src/common/distributed_ds/sequencer/global_sequence.h>
+#include <src/common/distributed_ds/score_index/DistributedScoreIndex.h>
 #include <src/common/configuration_manager.h>
 #include <src/common/singleton.h>
 #include <src/common/macros.h>
 #include <src/common/data_structure.h>
 #include <src/common/io_clients/io_client_factory.h>
 
+/* buffered ranges of one layer ordered by score, keyed by original file and range */
+typedef DistributedScoreIndex<std::pair<FileId,Segment>,BufferedSegment> LayerScoreIndex;
+
 class FileSegmentAuditor {
-    /* filename to offset_map pointer*/
+    /* file id to offset_map pointer*/
     typedef DistributedMap<Segment,std::pair<PosixFile,SegmentScore>> SegmentMap;
-    std::unordered_map<CharStruct,std::shared_ptr<SegmentMap>> file_segment_map;
-    DistributedHashMap<CharStruct, uint64_t> valid_buffered_dataset;
+    std::unordered_map<FileId,std::shared_ptr<SegmentMap>> file_segment_map;
+    DistributedHashMap<FileId, uint64_t> valid_buffered_dataset;
     std::shared_ptr<SegmentMap>* offsetMaps;
-    DistributedHashMap<CharStruct,uint32_t> file_active_status;
-    DistributedHashMap<uint8_t,std::multimap<double,std::pair<PosixFile,PosixFile>,std::greater<double>>> layer_score_map;
+    DistributedHashMap<FileId,uint32_t> file_active_status;
+    std::unordered_map<uint8_t,std::shared_ptr<LayerScoreIndex>> layer_scores;
     std::shared_ptr<RPC> rpc;
     std::shared_ptr<IOClientFactory> ioFactory;
     GlobalSequence file_seq;
     const std::string FILE_SEGMENT_AUDITOR="FILE_SEGMENT_AUDITOR";
+    /* merge of the offset maps adding the argument's frequency and lrf to a segment's score */
+    const std::string ADD_SCORE="ADD_SCORE";
+    /* merge of the active status subtracting the argument from an open count, never below zero */
+    const std::string DECREMENT_ACTIVE="DECREMENT_ACTIVE";
 
     ServerStatus CreateOffsetMap(Event event);
     ServerStatus MarkFileSegmentsActive(Event event);
     ServerStatus MarkFileSegmentsInactive(Event event);
     ServerStatus IncreaseFileSegmentFrequency(Event event);
+    ServerStatus IndexExtent(FileId file_id, Segment extent, Segment located_extent, PosixFile location, double score);
+    ServerStatus UnindexExtent(FileId file_id, Segment extent, Layer layer);
+    static uint16_t GetHoldingServer(const PosixFile &location);
+    static bool AddScore(bool exists, std::pair<PosixFile,SegmentScore> &value, const std::pair<PosixFile,SegmentScore> &delta);
+    static bool DecrementActive(bool exists, uint32_t &value, const uint32_t &delta);
 
 public:
     FileSegmentAuditor():file_segment_map(),file_active_status("FILE_ACTIVE_STATUS",CONF->is_server,CONF->my_server,CONF->num_servers),
-                         layer_score_map("LAYER_SCORE_MAP",CONF->is_server,CONF->my_server,CONF->num_servers),
+                         layer_scores(),
                          file_seq("FILE_INDEX",CONF->is_server,CONF->my_server,CONF->num_servers),
                          valid_buffered_dataset("VALID_SEQ",CONF->is_server,CONF->my_server,CONF->num_servers){
         rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",CONF->is_server,CONF->my_server,CONF->num_servers);
         ioFactory = Singleton<IOClientFactory>::GetInstance();
+        file_active_status.RegisterMerge(DECREMENT_ACTIVE,&FileSegmentAuditor::DecrementActive);
         offsetMaps=new std::shared_ptr<SegmentMap>[CONF->max_num_files];
         for (int i = 0; i < CONF->max_num_files; ++i) {
-            offsetMaps[i] = std::make_shared<SegmentMap>(std::to_string(i) + "_OFFSET",CONF->is_server,CONF->my_server,CONF->num_servers);
+            /* all segments of a file are kept by one server so overlap lookups are a single call */
+            offsetMaps[i] = std::make_shared<SegmentMap>(std::to_string(i) + "_OFFSET",CONF->is_server,CONF->my_server,CONF->num_servers,i % CONF->num_servers,
+                                                         OFFSET_MAP_SEGMENT_SIZE);
+            offsetMaps[i]->RegisterMerge(ADD_SCORE,&FileSegmentAuditor::AddScore);
         }
-        if(CONF->is_server){
-            MPI_Barrier(MPI_COMM_WORLD);
-            if(CONF->my_rank_server == 0){
-                Layer* current=Layer::FIRST;
-                while(current != nullptr){
-                    layer_score_map.Put(current->id_, std::multimap<double,std::pair<PosixFile,PosixFile>,std::greater<double>>());
-                    current = current->next;
-                }
-            }
-            MPI_Barrier(MPI_COMM_WORLD);
+        /* the scores of a layer are kept by one server so an update touches a single entry there */
+        Layer* current=Layer::FIRST;
+        while(current != nullptr){
+            layer_scores.emplace(current->id_,std::make_shared<LayerScoreIndex>("LAYER_SCORE_"+std::to_string(current->id_),
+                                 CONF->is_server,CONF->my_server,CONF->num_servers,current->id_ % CONF->num_servers));
+            current = current->next;
         }
     }
 
     ServerStatus Update(std::vector<Event> events);
 
-    ServerStatus UpdateOnMove(PosixFile source, PosixFile destination);
+    ServerStatus UpdateOnMove(const PosixFile &source, const PosixFile &destination);
 
     std::vector<std::tuple<Segment,SegmentScore, PosixFile>> FetchHeatMap(PosixFile file);
 
-    std::map<uint8_t, std::multimap<double,std::pair<PosixFile,PosixFile>,std::greater<double>>> FetchLayerScores();
+    std::shared_ptr<LayerScoreIndex> GetLayerScores(Layer layer);
 
     std::vector<std::pair<PosixFile,PosixFile>> GetDataLocation(PosixFile file);
 
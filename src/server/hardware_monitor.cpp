@@ -25,7 +25,7 @@
 #include "hardware_monitor.h"
 
 std::vector<Event> HardwareMonitor::FetchEvents() {
-    AutoTrace trace = AutoTrace("HardwareMonitor::FetchEvents");
+    AUTO_TRACE("HardwareMonitor::FetchEvents");
     event_queue.WaitForElement(CONF->my_server);
     std::vector<Event> events=std::vector<Event>();
     auto result = event_queue.Pop(CONF->my_server);
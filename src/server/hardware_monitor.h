@@ -98,7 +98,7 @@ class HardwareMonitor {
 public:
     HardwareMonitor():num_monitors(0),event_queue("HARDWARE_QUEUE",CONF->is_server,CONF->my_server,CONF->num_servers){
 
-        AutoTrace trace = AutoTrace("HardwareMonitor");
+        AUTO_TRACE("HardwareMonitor");
         Layer* current=Layer::FIRST;
         while(current != nullptr){
             if(current->io_client_type == IOClientType::LOCAL_POSIX_FILE){
@@ -111,7 +111,7 @@ public:
         }
     }
     ServerStatus AsyncMonitor(){
-        AutoTrace trace = AutoTrace("HardwareMonitor::AsyncMonitor");
+        AUTO_TRACE("HardwareMonitor::AsyncMonitor");
         monitor_threads = new std::thread[num_monitors];
         monitor__exit_signal = new std::promise<void>[num_monitors];
         Layer* current=Layer::FIRST;
@@ -135,7 +135,7 @@ public:
     }
     std::vector<Event> FetchEvents();
     void Stop(){
-        AutoTrace trace = AutoTrace("HardwareMonitor::Stop");
+        AUTO_TRACE("HardwareMonitor::Stop");
         for (int i = 0; i < num_monitors; ++i) {
             /* Issue server kill signals */
             monitor__exit_signal[i].set_value();
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#include <boost/stacktrace.hpp>
+#include "movement_engine.h"
+
+std::shared_ptr<MovementEngine::MovementPool> MovementEngine::GetPool(const Layer &source, const Layer &destination) {
+    AUTO_TRACE("MovementEngine::GetPool",source,destination);
+    uint16_t key = static_cast<uint16_t>(source.id_ << 8 | destination.id_);
+    std::lock_guard<std::mutex> lock(pools_mutex);
+    auto iter = pools.find(key);
+    if(iter != pools.end()) return iter->second;
+    auto pool = std::make_shared<MovementPool>();
+    std::string name = "move_"+std::to_string(source.id_)+"_"+std::to_string(destination.id_);
+    for(size_t i = 0; i < MOVEMENT_THREADS_PER_TIER_PAIR; ++i){
+        pool->threads.emplace_back(&MovementEngine::RunPool, this, pool, name);
+    }
+    pools.emplace(key,pool);
+    return pool;
+}
+
+ServerStatus MovementEngine::Execute(MoveTask &task) {
+    AUTO_TRACE("MovementEngine::Execute",task.source,task.destination,task.score);
+    if(!dataManager->HasCapacity(task.destination.GetSize(),task.destination.layer)){
+        /* the evictor fell behind: wake it up and drop this placement, the data is still read from its source */
+        evictor->Kick(task.destination.layer);
+        AUTO_TRACE("MovementEngine::Execute(no capacity)",task.destination.layer);
+        return SERVER_FAILED;
+    }
+    ServerStatus status = dataManager->Prefetch(task.source,task.destination);
+    if(status == SERVER_SUCCESS) auditor->UpdateOnMove(task.source,task.destination);
+    return status;
+}
+
+void MovementEngine::RunPool(std::shared_ptr<MovementPool> pool, std::string name) {
+    pthread_setname_np(pthread_self(), name.c_str());
+    while(true){
+        MoveTask task;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->task_available.wait(lock,[&pool]{ return pool->stop || !pool->tasks.empty(); });
+            if(pool->tasks.empty()) return;
+            task = std::move(pool->tasks.front());
+            pool->tasks.pop_front();
+        }
+        try{
+            Execute(task);
+        }catch(const std::exception& e){
+            std::cerr << e.what() << '\n';
+            std::cerr << boost::stacktrace::stacktrace();
+        }
+        dataManager->EndMove(task.original,task.source);
+    }
+}
+
+ServerStatus MovementEngine::Submit(FileId original, PosixFile &source, PosixFile &destination, double score) {
+    AUTO_TRACE("MovementEngine::Submit",original,source,destination,score);
+    if(!dataManager->BeginMove(original,source)) return SERVER_SUCCESS;
+    auto pool = GetPool(source.layer,destination.layer);
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->tasks.push_back(MoveTask{original,std::move(source),std::move(destination),score});
+    }
+    pool->task_available.notify_one();
+    return SERVER_SUCCESS;
+}
+
+ServerStatus MovementEngine::Stop() {
+    AUTO_TRACE("MovementEngine::Stop");
+    std::lock_guard<std::mutex> lock(pools_mutex);
+    for(auto &entry:pools){
+        {
+            std::lock_guard<std::mutex> pool_lock(entry.second->mutex);
+            entry.second->stop = true;
+        }
+        entry.second->task_available.notify_all();
+    }
+    for(auto &entry:pools){
+        for(auto &thread:entry.second->threads){
+            if(thread.joinable()) thread.join();
+        }
+    }
+    pools.clear();
+    return SERVER_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_MOVEMENT_ENGINE_H
+#define HFETCH_MOVEMENT_ENGINE_H
+
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <src/common/enumerations.h>
+#include <src/common/data_structure.h>
+#include <src/common/io_clients/io_client_factory.h>
+#include "file_segment_auditor.h"
+#include "tier_evictor.h"
+#include <src/common/io_clients/data_manager.h>
+
+/**
+ * Runs prefetch placements in the background. Every (source tier, destination tier) pair gets its own bounded
+ * pool of I/O threads so a slow tier only delays moves that touch it. Moves are tracked by the data manager under
+ * the original file they belong to; a move of a source range already in flight is merged into the running move
+ * and the auditor is only updated once a transfer completes.
+ */
+class MovementEngine {
+    typedef struct MoveTask{
+        FileId original;
+        PosixFile source;
+        PosixFile destination;
+        double score;
+    } MoveTask;
+    typedef struct MovementPool{
+        std::deque<MoveTask> tasks;
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable task_available;
+        bool stop;
+        MovementPool():tasks(),threads(),mutex(),task_available(),stop(false){}
+    } MovementPool;
+
+    std::shared_ptr<DataManager> dataManager;
+    std::shared_ptr<FileSegmentAuditor> auditor;
+    std::shared_ptr<TierEvictor> evictor;
+    /* one pool per (source layer id, destination layer id) */
+    std::unordered_map<uint16_t,std::shared_ptr<MovementPool>> pools;
+    std::mutex pools_mutex;
+
+    std::shared_ptr<MovementPool> GetPool(const Layer &source, const Layer &destination);
+    ServerStatus Execute(MoveTask &task);
+    void RunPool(std::shared_ptr<MovementPool> pool, std::string name);
+public:
+    MovementEngine():pools(){
+        AUTO_TRACE("MovementEngine");
+        dataManager = Singleton<DataManager>::GetInstance();
+        auditor = Singleton<FileSegmentAuditor>::GetInstance();
+        evictor = Singleton<TierEvictor>::GetInstance();
+    }
+    ~MovementEngine(){
+        Stop();
+    }
+    /**
+     * Queue a placement of data of the original file without waiting for it, moving source and destination
+     * into the queue. Returns SERVER_SUCCESS also when the move was merged into one already in flight.
+     */
+    ServerStatus Submit(FileId original, PosixFile &source, PosixFile &destination, double score);
+    /**
+     * Finish queued moves and join all I/O threads.
+     */
+    ServerStatus Stop();
+};
+
+
+#endif //HFETCH_MOVEMENT_ENGINE_H
@@ -32,6 +32,7 @@
 #include <src/common/configuration_manager.h>
 #include <src/common/enumerations.h>
 #include <src/common/distributed_ds/queue/DistributedMessageQueue.h>
+#include <src/common/distributed_ds/queue/EventRing.h>
 #include <src/common/distributed_ds/clock/global_clock.h>
 #include <src/server/event_manager.h>
 #include <src/server/hardware_monitor.h>
@@ -49,27 +50,51 @@ class Server {
     std::thread* client_server_workers,*monitor_server_workers;
     std::promise<void>* client_server_exit_signal,*monitor_server_exit_signal;
     DistributedMessageQueue<Event> app_event_queue;
+    EventRing event_ring;
+
+    /* collect up to max_prefetch_events from the rings of this worker and the overflow queue */
+    std::vector<Event> CollectEvents(int index){
+        AUTO_TRACE("Server::CollectEvents",index);
+        std::vector<Event> events=std::vector<Event>();
+        size_t max_events = CONF->max_prefetch_events;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(EVENT_WAIT_TIMEOUT_US);
+        bool batch_started = false;
+        while(events.size() < max_events){
+            uint32_t sequence = event_ring.Sequence(index);
+            event_ring.Drain(index, max_events - events.size(), events);
+            if(events.size() < max_events){
+                auto overflow = app_event_queue.PopBatch(CONF->my_server, max_events - events.size(), 0, 0);
+                events.insert(events.end(), overflow.begin(), overflow.end());
+            }
+            if(!batch_started && events.size() > 0){
+                /* first event taken: give the batch at most prefetch_window_us to fill up */
+                batch_started = true;
+                deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(CONF->prefetch_window_us);
+            }
+            if(events.size() >= max_events) break;
+            auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if(remaining <= 0) break;
+            event_ring.Wait(index, sequence, remaining);
+        }
+        return events;
+    }
 
     ServerStatus runClientServerInternal(std::future<void> futureObj,int index){
             std::string name="client_thread_"+std::to_string(index);
             pthread_setname_np(pthread_self(), name.c_str());
-            std::vector<Event> events=std::vector<Event>();
             int count=0;
-            while(futureObj.wait_for(std::chrono::milliseconds(1)) == std::future_status::timeout){
+            /* block on the doorbell instead of polling; the timeout only bounds how late the exit signal is seen */
+            while(futureObj.wait_for(std::chrono::seconds(0)) == std::future_status::timeout){
                 try{
-                    AutoTrace trace = AutoTrace("Server::runClientServerInternal");
-                    auto result = app_event_queue.Pop(CONF->my_server);
-                    if(result.first){
-                        events.push_back(result.second);
-                    }
-                    if(events.size() > 0 && (events.size() >= MAX_PREFETCH_EVENTS)){
+                    AUTO_TRACE("Server::runClientServerInternal");
+                    auto events = CollectEvents(index);
+                    if(events.size() > 0){
                         eventManager->handle(events);
-                        events.clear();
                         count=0;
                     }else{
                         if(count==0 && index==0) printf("Server %d, No Events in Queue\n",CONF->my_server);
+                        count++;
                     }
-                    count++;
                 }catch(const std::exception& e){
                     std::cerr << e.what() << '\n';
                     std::cerr << boost::stacktrace::stacktrace();
@@ -98,7 +123,7 @@ class Server {
     }
 public:
     static InputArgs InitializeServer(int argc, char *argv[]){
-        AutoTrace trace = AutoTrace("Server::InitializeServer");
+        AUTO_TRACE("Server::InitializeServer");
         InputArgs args = parse_opts(argc,argv);
         CONF;
         CONF->BuildLayers(args.layers,args.layer_count_);
@@ -106,6 +131,9 @@ public:
         CONF->max_num_files=args.max_files;
         CONF->ranks_per_server=args.ranks_per_server_;
         CONF->num_workers=args.num_workers;
+        CONF->max_prefetch_events=args.max_prefetch_events;
+        CONF->prefetch_window_us=args.prefetch_window_us;
+        CONF->dpeType=args.dpe_type;
         CONF->is_server=true;
         CONF->num_servers=CONF->comm_size;
         CONF->UpdateServerComm();
@@ -115,7 +143,7 @@ public:
     }
 
     static InputArgs InitializeClients(int argc, char *argv[]){
-        AutoTrace trace = AutoTrace("Server::InitializeClients");
+        AUTO_TRACE("Server::InitializeClients");
         InputArgs args = parse_opts(argc,argv);
         CONF;
         CONF->BuildLayers(args.layers,args.layer_count_);
@@ -123,6 +151,9 @@ public:
         CONF->ranks_per_server=args.ranks_per_server_;
         CONF->comm_threads_per_server=args.comm_threads_per_server;
         CONF->num_workers=args.num_workers;
+        CONF->max_prefetch_events=args.max_prefetch_events;
+        CONF->prefetch_window_us=args.prefetch_window_us;
+        CONF->dpeType=args.dpe_type;
         CONF->is_server=false;
         CONF->num_servers=args.num_servers;
         CONF->my_server=CONF->my_rank_world/args.ranks_per_server_;
@@ -134,8 +165,9 @@ public:
 
     Server(size_t num_workers_=1):num_workers(num_workers_),
     app_event_queue("APPLICATION_QUEUE",CONF->is_server,CONF->my_server,CONF->num_servers),
-    clock("GLOBAL_CLOCK",CONF->is_server,CONF->my_server,CONF->num_servers){
-        AutoTrace trace = AutoTrace("Server",num_workers_);
+    clock("GLOBAL_CLOCK",CONF->is_server,CONF->my_server,CONF->num_servers),
+    event_ring("EVENT_RING",CONF->is_server,CONF->my_server,CONF->ranks_per_server,CONF->my_rank_world%CONF->ranks_per_server){
+        AUTO_TRACE("Server",num_workers_);
         rpc=Singleton<RPC>::GetInstance("RPC_SERVER_LIST",CONF->is_server,CONF->my_server,CONF->comm_size);
         if(CONF->is_server){
             rpc->run(CONF->comm_threads_per_server);
@@ -149,8 +181,9 @@ public:
     }
 
     ServerStatus async_run(size_t numWorker=1){
-        AutoTrace trace = AutoTrace("Server::async_run",numWorker);
+        AUTO_TRACE("Server::async_run",numWorker);
         num_workers=numWorker;
+        event_ring.SetWorkers(numWorker);
         if(numWorker > 0){
             client_server_workers=new std::thread[numWorker];
             client_server_exit_signal=new std::promise<void>[numWorker];
@@ -166,25 +199,30 @@ public:
     }
 
     std::vector<std::pair<PosixFile,PosixFile>> GetDataLocation(PosixFile file){
-        AutoTrace trace = AutoTrace("Server::GetDataLocation",file);
+        AUTO_TRACE("Server::GetDataLocation",file);
         return auditor->GetDataLocation(file);
     }
 
     ServerStatus pushEvents(Event event){
-        AutoTrace trace = AutoTrace("Server::pushEvents",event);
+        AUTO_TRACE("Server::pushEvents",event);
         event.time = clock.GetTimeServer(CONF->my_server);
-        app_event_queue.Push(event,CONF->my_server);
+        if(!event_ring.Push(event)){
+            /* ring is full: fall back to the shared queue and wake the worker to drain it */
+            app_event_queue.Push(event,CONF->my_server);
+            event_ring.Notify();
+        }
     }
 
     void stop(){
-        AutoTrace trace = AutoTrace("Server::stop");
+        AUTO_TRACE("Server::stop");
         int count=0;
-        size_t size=app_event_queue.Size(CONF->my_server);
+        size_t size=app_event_queue.Size(CONF->my_server)+event_ring.Size();
         while(size > 0){
             if(count++==0) printf("Server %d, %d Events in Queue\n", CONF->my_server, static_cast<int>(size));
-            size = app_event_queue.Size(CONF->my_server);
+            size = app_event_queue.Size(CONF->my_server)+event_ring.Size();
         }
         printf("Server %d, No Events in Queue\n",CONF->my_server);
+        printf("Server %d, %llu RPC connections for %llu RPC calls\n",CONF->my_server,rpc->GetConnectCount(),rpc->GetCallCount());
         for (int i = 0; i < num_workers; ++i) {
 
             /* Issue server kill signals */
@@ -194,6 +232,7 @@ public:
             /*if(monitor_server_workers[i].joinable()) monitor_server_workers[i].join();*/
             if(client_server_workers[i].joinable()) client_server_workers[i].join();
         }
+        if(CONF->is_server) Singleton<MovementEngine>::GetInstance()->Stop();
     }
 
 };
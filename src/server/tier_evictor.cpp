@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#include <cfloat>
+#include <boost/stacktrace.hpp>
+#include "tier_evictor.h"
+
+TierEvictor::TierEvictor():tiers() {
+    AUTO_TRACE("TierEvictor");
+    dataManager = Singleton<DataManager>::GetInstance();
+    ledger = Singleton<TierLedger>::GetInstance("TIER_LEDGER",CONF->is_server,CONF->my_server,CONF->num_servers);
+    Layer* current=Layer::FIRST;
+    while(current != nullptr){
+        /* a shared tier is evicted only by the server holding its count */
+        bool evicted_here = !TierLedger::IsShared(*current) || current->id_ % CONF->num_servers == CONF->my_server;
+        if(*current != *Layer::LAST && evicted_here){
+            auto tier = std::make_shared<TierThread>(*current);
+            tier->thread = std::thread(&TierEvictor::Run, this, tier);
+            tiers.emplace(current->id_,tier);
+        }
+        current = current->next;
+    }
+}
+
+void TierEvictor::Run(std::shared_ptr<TierThread> tier) {
+    std::string name = "evict_"+std::to_string(tier->layer.id_);
+    pthread_setname_np(pthread_self(), name.c_str());
+    double capacity = tier->layer.capacity_mb_*MB;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(tier->mutex);
+            tier->wake_up.wait_for(lock,std::chrono::milliseconds(EVICTION_INTERVAL_MS),[&tier]{ return tier->stop || tier->kicked; });
+            if(tier->stop) return;
+            tier->kicked = false;
+        }
+        double usage = ledger->GetCurrentUsage(tier->layer);
+        if(usage < capacity * EVICTION_HIGH_WATERMARK) continue;
+        try{
+            AUTO_TRACE("TierEvictor::Run",tier->layer,usage);
+            dataManager->Evict(static_cast<long>(usage - capacity * EVICTION_LOW_WATERMARK),DBL_MAX,tier->layer);
+        }catch(const std::exception& e){
+            std::cerr << e.what() << '\n';
+            std::cerr << boost::stacktrace::stacktrace();
+        }
+    }
+}
+
+void TierEvictor::Kick(const Layer &layer) {
+    AUTO_TRACE("TierEvictor::Kick",layer);
+    auto iter = tiers.find(layer.id_);
+    if(iter == tiers.end()) return;
+    {
+        std::lock_guard<std::mutex> lock(iter->second->mutex);
+        iter->second->kicked = true;
+    }
+    iter->second->wake_up.notify_one();
+}
+
+ServerStatus TierEvictor::Stop() {
+    AUTO_TRACE("TierEvictor::Stop");
+    for(auto &entry:tiers){
+        {
+            std::lock_guard<std::mutex> lock(entry.second->mutex);
+            entry.second->stop = true;
+        }
+        entry.second->wake_up.notify_all();
+    }
+    for(auto &entry:tiers){
+        if(entry.second->thread.joinable()) entry.second->thread.join();
+    }
+    tiers.clear();
+    return SERVER_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#ifndef HFETCH_TIER_EVICTOR_H
+#define HFETCH_TIER_EVICTOR_H
+
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <src/common/enumerations.h>
+#include <src/common/data_structure.h>
+#include <src/common/io_clients/io_client_factory.h>
+#include <src/common/io_clients/tier_ledger.h>
+#include "file_segment_auditor.h"
+#include <src/common/io_clients/data_manager.h>
+
+/**
+ * Keeps every tier but the last below its high watermark ahead of demand. A thread per tier wakes
+ * up every EVICTION_INTERVAL_MS, or when a placement found the tier full, and once the usage is
+ * above EVICTION_HIGH_WATERMARK evicts the lowest scored data until it is down to
+ * EVICTION_LOW_WATERMARK, so placements normally find free space without evicting themselves.
+ */
+class TierEvictor {
+    typedef struct TierThread{
+        Layer layer;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake_up;
+        bool kicked;
+        bool stop;
+        TierThread(Layer layer_):layer(layer_),thread(),mutex(),wake_up(),kicked(false),stop(false){}
+    } TierThread;
+
+    std::shared_ptr<DataManager> dataManager;
+    std::shared_ptr<TierLedger> ledger;
+    /* one thread per layer id */
+    std::unordered_map<uint8_t,std::shared_ptr<TierThread>> tiers;
+
+    void Run(std::shared_ptr<TierThread> tier);
+public:
+    TierEvictor();
+    ~TierEvictor(){
+        Stop();
+    }
+    /**
+     * Wake up the evictor of layer without waiting for it.
+     */
+    void Kick(const Layer &layer);
+    /**
+     * Stop and join all evictor threads.
+     */
+    ServerStatus Stop();
+};
+
+
+#endif //HFETCH_TIER_EVICTOR_H
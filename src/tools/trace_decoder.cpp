@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+/**
+ * Decodes the binary records written by AutoTrace.
+ * Usage: hfetch_trace_decoder <hfetch_trace_<pid>.sites> <hfetch_trace_<pid>_<tid>.bin>...
+ * Prints one line per record (thread;site;start_ns;duration_us) followed by a per site summary.
+ */
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <src/common/debug.h>
+
+int main(int argc, char*argv[]){
+    if(argc < 3){
+        fprintf(stderr, "Usage: %s <sites file> <trace file>...\n", argv[0]);
+        return 1;
+    }
+    std::map<uint32_t,std::string> sites;
+    std::ifstream sites_file(argv[1]);
+    std::string line;
+    while(std::getline(sites_file, line)){
+        std::stringstream stream(line);
+        std::string id, name;
+        std::getline(stream, id, ';');
+        std::getline(stream, name, ';');
+        sites[static_cast<uint32_t>(std::stoul(id))] = name;
+    }
+    /* site to number of calls and total time */
+    std::map<uint32_t,std::pair<uint64_t,uint64_t>> summary;
+    printf("thread;site;start_ns;duration_us\n");
+    for(int i = 2; i < argc; ++i){
+        FILE* trace = fopen(argv[i], "rb");
+        if(trace == NULL){
+            perror(argv[i]);
+            continue;
+        }
+        TraceRecord record;
+        while(fread(&record, sizeof(TraceRecord), 1, trace) == 1){
+            auto site = sites.find(record.site);
+            const char* name = site == sites.end() ? "unknown" : site->second.c_str();
+            printf("%u;%s;%llu;%.3f\n", record.thread, name, (unsigned long long)record.start_ns, record.duration_ns/1000.0);
+            summary[record.site].first++;
+            summary[record.site].second += record.duration_ns;
+        }
+        fclose(trace);
+    }
+    printf("site;calls;total_ms;mean_us\n");
+    for(auto entry:summary){
+        auto site = sites.find(entry.first);
+        const char* name = site == sites.end() ? "unknown" : site->second.c_str();
+        printf("%s;%llu;%.3f;%.3f\n", name, (unsigned long long)entry.second.first,
+               entry.second.second/1000000.0, entry.second.second/1000.0/entry.second.first);
+    }
+    return 0;
+}
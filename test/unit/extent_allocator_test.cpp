@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2019  SCS Lab <scs-help@cs.iit.edu>, Hariharan
+ * Devarajan <hdevarajan@hawk.iit.edu>, Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of HFetch
+ * 
+ * HFetch is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+//
+// Created by hariharan on 3/19/19.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <src/common/io_clients/extent_allocator.h>
+
+#define CHECK(condition) do{ if(!(condition)){ \
+    fprintf(stderr,"%s:%d: check failed: %s\n",__FILE__,__LINE__,#condition); exit(EXIT_FAILURE);} }while(0)
+
+const size_t REGION=64*1024;
+
+/* free list holding one empty region per container, as the stores set it up. */
+static void AddRegions(FreeExtentList *list, size_t regions){
+    for(size_t i=0;i<regions;++i) list->insert(FreeExtentValue(i*REGION,REGION));
+}
+
+static void TestAllocate(FreeExtentList *list){
+    list->clear();
+    AddRegions(list,2);
+    ExtentAllocator allocator(list,REGION);
+    size_t a,b,c;
+    CHECK(allocator.Allocate(4096,a) && a == 0);
+    CHECK(allocator.Allocate(8192,b) && b == 4096);
+    /* first fit: the rest of the first region serves before the second */
+    CHECK(allocator.Allocate(REGION-12288,c) && c == 12288);
+    CHECK(allocator.Allocate(4096,c) && c == REGION);
+    /* nothing past the limit */
+    CHECK(!allocator.Allocate(REGION,c,2*REGION-1));
+    CHECK(!allocator.Allocate(2*REGION,c));
+    CHECK(allocator.FreeBytesBelow(REGION) == 0);
+    CHECK(allocator.FreeBytesBelow(2*REGION) == REGION-4096);
+}
+
+static void TestFreeMerging(FreeExtentList *list){
+    list->clear();
+    AddRegions(list,2);
+    ExtentAllocator allocator(list,REGION);
+    size_t a,b,c,d;
+    CHECK(allocator.Allocate(REGION/2,a) && allocator.Allocate(REGION/2,b));
+    CHECK(allocator.Allocate(REGION/2,c) && allocator.Allocate(REGION/2,d));
+    CHECK(list->empty());
+    /* neighbours in one region merge back into one extent */
+    allocator.Free(a,REGION/2);
+    allocator.Free(b,REGION/2);
+    CHECK(list->size() == 1 && list->begin()->first == 0 && list->begin()->second == REGION);
+    /* but never across the boundary into the next region */
+    allocator.Free(c,REGION/2);
+    CHECK(list->size() == 2);
+    allocator.Free(d,REGION/2);
+    CHECK(list->size() == 2 && list->rbegin()->first == REGION && list->rbegin()->second == REGION);
+    size_t e;
+    CHECK(!allocator.Allocate(REGION+1,e));
+}
+
+static void TestGrow(FreeExtentList *list){
+    list->clear();
+    AddRegions(list,2);
+    ExtentAllocator allocator(list,REGION);
+    size_t a,b;
+    CHECK(allocator.Allocate(4096,a) && a == 0);
+    CHECK(allocator.Grow(a,4096,8192));
+    CHECK(list->begin()->first == 8192);
+    CHECK(allocator.Allocate(REGION-8192,b) && b == 8192);
+    allocator.Free(b,REGION-8192);
+    /* up to the end of the region is fine */
+    CHECK(allocator.Grow(a,8192,REGION));
+    /* an extent ending at the boundary must not take the next region's free extent */
+    CHECK(!allocator.Grow(a,REGION,REGION+4096));
+    CHECK(list->size() == 1 && list->begin()->first == REGION && list->begin()->second == REGION);
+    /* nor may one cross it from inside the region */
+    allocator.Free(a+REGION/2,REGION/2);
+    CHECK(!allocator.Grow(a,REGION/2,REGION/2+REGION));
+    /* growing into bytes in use fails */
+    size_t c;
+    CHECK(allocator.Allocate(4096,c) && c == REGION/2);
+    CHECK(!allocator.Grow(a,REGION/2,REGION/2+4096));
+}
+
+int main(){
+    std::string name="HFETCH_EXTENT_ALLOCATOR_TEST_"+std::to_string(getpid());
+    bip::shared_memory_object::remove(name.c_str());
+    bip::managed_shared_memory segment(bip::create_only,name.c_str(),1024*1024);
+    FreeExtentList *list = segment.construct<FreeExtentList>("free")(std::less<size_t>(),segment.get_segment_manager());
+    TestAllocate(list);
+    TestFreeMerging(list);
+    TestGrow(list);
+    bip::shared_memory_object::remove(name.c_str());
+    printf("extent allocator tests passed\n");
+    return EXIT_SUCCESS;
+}